@@ -0,0 +1,64 @@
+import subprocess
+import csv
+import os
+import re
+import sys
+import shlex
+
+# storages accepted by the -costs option
+BACKENDS = ["MATRIX", "PACKED", "QUANT32", "QUANT16", "ORACLE"]
+
+# random instances generated with -n, together with the TSPLIB files in data/
+RANDOM_SIZES = [1000, 2000, 5000]
+
+# a single greedy start refined without time limit, so that every storage completes the same search
+ALGORITHM = "2OPT"
+REPETITIONS = 3
+SEED = "123"
+
+# refined greedy from node 0: cost 8980.918318 -> 8155.730291 in 0.020 ms, length 8155.730291
+LOG_PATTERN = re.compile(r"refined greedy from node \d+: cost [\d.]+ -> [\d.]+ in ([\d.]+) ms, length ([\d.]+)")
+
+def run(instance_args, backend):
+    str_exec = f"make/bin/tsp {instance_args} -v -alg {ALGORITHM} -seed {SEED} -costs {backend}"
+    output = subprocess.run(shlex.split(str_exec), capture_output=True, text=True).stdout
+
+    # the reported cost of quantized storages is a sum of rounded costs, the length is exact
+    match = LOG_PATTERN.search(output)
+    return float(match.group(2)), float(match.group(1))
+
+# python scripts/bench_costs.py [output.csv]
+# compares the tour length reached by 2opt and the refinement time of the cost storages on the
+# same instances, fastest of REPETITIONS runs
+if __name__ == '__main__':
+    csv_filename = sys.argv[1] if len(sys.argv) > 1 else "results/costs.csv"
+    os.makedirs(os.path.dirname(csv_filename) or ".", exist_ok=True)
+
+    instances = []
+    for root, _, files in os.walk("data"):
+        for file in files:
+            if file.endswith(".tsp"):
+                instances.append((file, f"-f {os.path.join(root, file)}"))
+    for n in RANDOM_SIZES:
+        instances.append((f"random_{n}", f"-n {n}"))
+
+    with open(csv_filename, 'w', newline='') as csvfile:
+        writer = csv.writer(csvfile)
+        writer.writerow(["instance", "backend", "length", "gap_vs_matrix_%", "refine_ms", "speedup_vs_matrix"])
+
+        for name, args in instances:
+            reference = None
+            for backend in BACKENDS:
+                try:
+                    length, ms = min((run(args, backend) for _ in range(REPETITIONS)), key=lambda r: r[1])
+                except AttributeError:
+                    print(f"Skipping {backend} on {name}")
+                    continue
+
+                if reference is None:
+                    reference = (length, ms)
+
+                gap = 100.0 * (length - reference[0]) / reference[0]
+                speedup = reference[1] / ms if ms > 0 else float("inf")
+                print(f"{name:>15} {backend:>8}: length {length:.4f} ({gap:+.4f}%), {ms:.3f} ms ({speedup:.2f}x)")
+                writer.writerow([name, backend, f"{length:.4f}", f"{gap:.4f}", f"{ms:.3f}", f"{speedup:.2f}"])
@@ -0,0 +1,54 @@
+import subprocess
+import csv
+import os
+import re
+import sys
+import shlex
+
+# local searches compared on the same greedy starting tour
+VARIANTS = [("2opt", ""), ("2opt+oropt", "--oropt")]
+
+# random instances generated with -n, together with data/berlin52.tsp
+RANDOM_SIZES = [1000, 5000, 10000]
+
+# a single greedy start refined without time limit, so that only the local search is measured
+ALGORITHM = "2OPT"
+REPETITIONS = 3
+SEED = "123"
+
+# refined greedy from node 0: cost 8980.918318 -> 8155.730291 in 0.020 ms, length 8155.730291
+LOG_PATTERN = re.compile(r"refined greedy from node \d+: cost ([\d.]+) -> ([\d.]+) in ([\d.]+) ms")
+
+def run(instance_args, extra=""):
+    str_exec = f"make/bin/tsp {instance_args} -v -alg {ALGORITHM} -seed {SEED} {extra}"
+    output = subprocess.run(shlex.split(str_exec), capture_output=True, text=True).stdout
+
+    match = LOG_PATTERN.search(output)
+    return float(match.group(1)), float(match.group(2)), float(match.group(3))
+
+# python scripts/bench_oropt.py [output.csv]
+# cost reduction per millisecond of refinement of 2opt alone and of 2opt alternated with Or-opt,
+# fastest of REPETITIONS runs
+if __name__ == '__main__':
+    csv_filename = sys.argv[1] if len(sys.argv) > 1 else "results/oropt.csv"
+    os.makedirs(os.path.dirname(csv_filename) or ".", exist_ok=True)
+
+    instances = [("berlin52", "-f data/berlin52.tsp")]
+    for n in RANDOM_SIZES:
+        instances.append((f"random_{n}", f"-n {n}"))
+
+    with open(csv_filename, 'w', newline='') as csvfile:
+        writer = csv.writer(csvfile)
+        writer.writerow(["instance", "variant", "greedy_cost", "cost", "refine_ms", "reduction_per_ms"])
+
+        for name, args in instances:
+            for variant, extra in VARIANTS:
+                try:
+                    greedy_cost, cost, ms = min((run(args, extra) for _ in range(REPETITIONS)), key=lambda r: r[2])
+                except AttributeError:
+                    print(f"Skipping {variant} on {name}")
+                    continue
+
+                reduction = (greedy_cost - cost) / max(ms, 1e-6)
+                print(f"{name:>15} {variant:>12}: cost {cost:.2f} (greedy {greedy_cost:.2f}), {ms:.3f} ms, {reduction:.2f} per ms")
+                writer.writerow([name, variant, f"{greedy_cost:.2f}", f"{cost:.2f}", f"{ms:.3f}", f"{reduction:.4f}"])
@@ -0,0 +1,68 @@
+import subprocess
+import csv
+import os
+import random
+import re
+import sys
+import shlex
+
+# readers accepted by the -parser option, STDIO is the reference
+PARSERS = ["STDIO", "MMAP"]
+
+# nodes of the generated TSPLIB files, the largest ones are split among threads by MMAP
+SIZES = [10000, 100000, 1000000]
+THREADS = [1, 4]
+
+REPETITIONS = 3
+SEED = 123
+
+# parsed 1000 nodes with the mmap parser: 0.1 MB in 0.001 s, 60.0 MB/s
+LOG_PATTERN = re.compile(r"parsed (\d+) nodes with the \w+ parser: ([\d.]+) MB in ([\d.]+) s, ([\d.]+) MB/s")
+
+def generate(path, n):
+    rng = random.Random(SEED)
+    with open(path, 'w') as f:
+        f.write(f"NAME : bench_{n}\nTYPE : TSP\nDIMENSION : {n}\nEDGE_WEIGHT_TYPE : EUC_2D\nNODE_COORD_SECTION\n")
+        for i in range(1, n + 1):
+            f.write(f"{i} {rng.uniform(0, 1e6):.6f} {rng.uniform(0, 1e6):.6f}\n")
+        f.write("EOF\n")
+
+def run(path, parser, threads):
+    # no time for the algorithm and no precomputed costs, so the run is dominated by the parsing
+    str_exec = f"make/bin/tsp -f {path} -v -alg GREEDY -t 0 -costs ORACLE -cand NONE -parser {parser} -threads {threads}"
+    output = subprocess.run(shlex.split(str_exec), capture_output=True, text=True).stdout
+
+    match = LOG_PATTERN.search(output)
+    return float(match.group(2)), float(match.group(3)), float(match.group(4))
+
+# python scripts/bench_parser.py [output.csv]
+# compares the throughput of the TSPLIB readers on generated files, best of REPETITIONS runs
+if __name__ == '__main__':
+    csv_filename = sys.argv[1] if len(sys.argv) > 1 else "results/parser.csv"
+    os.makedirs(os.path.dirname(csv_filename) or ".", exist_ok=True)
+    os.makedirs("results/bench", exist_ok=True)
+
+    with open(csv_filename, 'w', newline='') as csvfile:
+        writer = csv.writer(csvfile)
+        writer.writerow(["nodes", "parser", "threads", "mb", "seconds", "mb_per_s", "speedup_vs_stdio"])
+
+        for n in SIZES:
+            path = os.path.join("results/bench", f"bench_{n}.tsp")
+            if not os.path.exists(path):
+                generate(path, n)
+
+            reference = None
+            for parser in PARSERS:
+                for threads in THREADS if parser == "MMAP" else [1]:
+                    try:
+                        mb, seconds, throughput = max((run(path, parser, threads) for _ in range(REPETITIONS)), key=lambda r: r[2])
+                    except AttributeError:
+                        print(f"Skipping {parser} on {n} nodes")
+                        continue
+
+                    if reference is None:
+                        reference = throughput
+
+                    speedup = throughput / reference if reference > 0 else float("inf")
+                    print(f"{n:>8} {parser:>6} x{threads}: {mb:.1f} MB in {seconds:.3f}s, {throughput:.1f} MB/s ({speedup:.2f}x)")
+                    writer.writerow([n, parser, threads, f"{mb:.1f}", f"{seconds:.3f}", f"{throughput:.1f}", f"{speedup:.2f}"])
@@ -1,5 +1,16 @@
 #include "heuristics.h"
 
+static ERROR_CODE h_multistart(instance* inst, bool refine);
+static ERROR_CODE h_greedy_matrix(instance* inst, uint64_t* visited, int starting_node, int* solution_path, double* solution_cost, double bound);
+static ERROR_CODE h_greedy_tree(instance* inst, kdtree* tree, int starting_node, int* solution_path, double* solution_cost, double bound);
+
+/**
+ * @brief Words of the visited bitmap of the matrix greedy, one bit per node
+ */
+static inline int h_visited_words(int nnodes){
+    return (nnodes + 63) / 64;
+}
+
 //================================================================================
 // NEAREST NEIGHBOUR HEURISTIC
 //================================================================================
@@ -24,76 +35,287 @@ ERROR_CODE h_Greedy(instance* inst){
 }
 
 ERROR_CODE h_Greedy_iterative(instance* inst){
-    ERROR_CODE e = OK;
+    log_info("running GREEDY from every node");
+    return h_multistart(inst, false);
+}
+
+ERROR_CODE h_greedy_2opt(instance* inst){
+    log_info("running GREEDY + 2OPT from every node");
+    return h_multistart(inst, true);
+}
+
+/**
+ * @brief Greedy from the starting node refined by a local search, alternated with Or-opt if set.
+ * The wall time of the refinement alone is logged, so that local searches can be compared per ms
+ */
+static ERROR_CODE h_greedy_refine(instance* inst, ERROR_CODE (*refine)(instance*, tsp_solution*)){
     tsp_solution solution = tsp_init_solution(inst->nnodes);
 
-    for(int i=0; i<inst->nnodes; i++){
-        if(inst->options_t.timelimit != -1.0){
-            double ex_time = utils_timeelapsed(inst->c);
-            if(ex_time > inst->options_t.timelimit){
-                e = DEADLINE_EXCEEDED;
-                break;
-            }
+    ERROR_CODE error = h_greedyutil(inst, inst->starting_node, solution.path, &solution.cost);
+    if(!err_ok(error)){
+        log_error("code %d : greedy did not finish correctly", error);
+        free(solution.path);
+        return error;
+    }
+
+    log_debug("greedy solution: cost: %f", solution.cost);
+
+    double greedy_cost = solution.cost;
+    double start = deadline_timestamp();
+    ERROR_CODE e = refine(inst, &solution);
+
+    // Or-opt moves segments that the local search reaches only through its candidates
+    double previous_cost = __DBL_MAX__;
+    while(err_ok(e) && inst->options_t.oropt && solution.cost < previous_cost + EPSILON){
+        previous_cost = solution.cost;
+        e = ref_oropt(inst, &solution);
+        if(err_ok(e) && solution.cost < previous_cost + EPSILON){
+            e = refine(inst, &solution);
+        }
+    }
+
+    if(!err_ok(e)){
+        log_error("code %d : error in local search", e);
+    }else{
+        double ms = (deadline_timestamp() - start) * 1000;
+        log_info("refined greedy from node %d: cost %f -> %f in %.3f ms, length %f", inst->starting_node, greedy_cost, solution.cost, ms, tsp_tour_length(inst, solution.path));
+    }
+
+    free(solution.path);
+
+    return e;
+}
+
+ERROR_CODE h_greedy_2opt_single(instance* inst){
+    return h_greedy_refine(inst, ref_2opt);
+}
+
+ERROR_CODE h_greedy_3opt(instance* inst){
+    return h_greedy_refine(inst, ref_3opt);
+}
+
+ERROR_CODE h_greedy_lk(instance* inst){
+    return h_greedy_refine(inst, ref_lk);
+}
+
+//================================================================================
+// MULTI-START
+//================================================================================
+
+/**
+ * @brief Best tour found by one worker of the multi-start
+ */
+typedef struct {
+    tsp_solution best;
+    int start;                  // starting node of best, -1 if none
+    ERROR_CODE e;
+} h_multistart_worker;
+
+/**
+ * @brief State shared by the workers of the multi-start. Starting nodes are handed out
+ * by an atomic counter; the incumbent is only a bound, the result is reduced from
+ * the workers at the end, so it does not depend on the scheduling
+ */
+typedef struct {
+    instance* inst;
+    bool refine;                // refine every greedy tour with 2opt (and Or-opt)
+    kdtree* tree;               // tree forked by the workers, NULL with the cost matrix
+    int next_start;             // next starting node to hand out
+    double incumbent;           // best cost found so far by any worker
+    h_multistart_worker* workers;
+} h_multistart_ctx;
+
+/**
+ * @brief Lowers the incumbent to cost with a CAS loop
+ * 
+ * @return true if cost is the new incumbent
+ */
+static bool h_multistart_publish(h_multistart_ctx* ms, double cost){
+    double current;
+    __atomic_load(&ms->incumbent, &current, __ATOMIC_ACQUIRE);
+    while(cost < current){
+        if(__atomic_compare_exchange(&ms->incumbent, &current, &cost, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)){
+            return true;
+        }
+    }
+    return false;
+}
+
+static void h_multistart_task(void* ctx, int thread_id, int nthreads){
+    (void) nthreads;
+    h_multistart_ctx* ms = (h_multistart_ctx*) ctx;
+    instance* inst = ms->inst;
+    h_multistart_worker* w = &ms->workers[thread_id];
+
+    // per-thread scratch, allocated here so that it lives on the memory node of the worker
+    tsp_solution solution = tsp_init_solution(inst->nnodes);
+    uint64_t* visited = ms->tree == NULL ? (uint64_t*)malloc(h_visited_words(inst->nnodes) * sizeof(uint64_t)) : NULL;
+    kdtree tree;
+    bool tree_forked = ms->tree != NULL && err_ok(kd_fork(&tree, ms->tree));
+    tour t;
+    bool tour_allocated = ms->refine && err_ok(tour_init(&t, inst->nnodes));
+
+    if(solution.path == NULL || (ms->tree == NULL ? visited == NULL : !tree_forked) || (ms->refine && !tour_allocated)){
+        log_error("code %d : cannot allocate the scratch of worker %d", RESOURCE_EXHAUSTED, thread_id);
+        w->e = RESOURCE_EXHAUSTED;
+    }
+
+    while(w->e == OK && !deadline_expired(&inst->deadline)){
+        int i = __atomic_fetch_add(&ms->next_start, 1, __ATOMIC_RELAXED);
+        if(i >= inst->nnodes){
+            break;
+        }
+
+        // plain greedy tours are pruned as soon as they cost more than the incumbent,
+        // the bound is strict so ties with the best tour are always completed
+        double bound = __DBL_MAX__;
+        if(!ms->refine){
+            __atomic_load(&ms->incumbent, &bound, __ATOMIC_ACQUIRE);
         }
 
         log_debug("starting greedy with node %d", i);
-        ERROR_CODE error = h_greedyutil(inst, i, solution.path, &solution.cost);
-        if(!err_ok(error)){
-            log_error("code %d : error in iteration %d of greedy iterative", error, i);
+        ERROR_CODE error = tree_forked ?
+            h_greedy_tree(inst, &tree, i, solution.path, &solution.cost, bound) :
+            h_greedy_matrix(inst, visited, i, solution.path, &solution.cost, bound);
+        if(error == DEADLINE_EXCEEDED){
+            break;
+        }else if(error == CANCELLED){
             continue;
+        }else if(!err_ok(error)){
+            log_error("code %d : error in greedy from node %d", error, i);
+            w->e = error;
+            break;
         }
 
-        if(solution.cost < inst->best_solution.cost){
-            log_info("found new best, node %d", i);
-            inst->starting_node = i;
-            error = tsp_update_best_solution(inst, &solution);
+        if(ms->refine){
+            log_debug("greedy solution: cost: %f", solution.cost);
+
+            tour_from_successors(&t, solution.path);
+            error = ref_2opt_tour(inst, &t, &solution.cost);
+
+            // Or-opt fixes what 2opt leaves behind, then 2opt runs again on the new tour
+            double previous_cost = __DBL_MAX__;
+            while(error == OK && inst->options_t.oropt && solution.cost < previous_cost + EPSILON){
+                previous_cost = solution.cost;
+                error = ref_oropt_tour(inst, &t, &solution.cost);
+                if(error == OK && solution.cost < previous_cost + EPSILON){
+                    error = ref_2opt_tour(inst, &t, &solution.cost);
+                }
+            }
+
+            tour_to_successors(&t, solution.path);
+
+            // a refinement stopped by the time limit still leaves a valid tour
             if(!err_ok(error)){
-                log_error("code %d : error in updating best solution of greedy iterative in iteration %d", error, i);
-                continue;
+                log_error("code %d : error in 2opt from node %d", error, i);
+                w->e = error;
+                break;
             }
         }
+
+        // ties go to the smallest starting node, as in a sequential scan
+        if(solution.cost < w->best.cost || (solution.cost == w->best.cost && i < w->start)){
+            memcpy(w->best.path, solution.path, inst->nnodes * sizeof(int));
+            w->best.cost = solution.cost;
+            w->start = i;
+        }
+
+        if(h_multistart_publish(ms, solution.cost)){
+            log_info("found new best, node %d, cost %f", i, solution.cost);
+        }
     }
 
     free(solution.path);
-
-    return e;
+    free(visited);
+    if(tree_forked){
+        kd_free(&tree);
+    }
+    if(tour_allocated){
+        tour_free(&t);
+    }
 }
 
-ERROR_CODE h_greedy_2opt(instance* inst){
+/**
+ * @brief Runs greedy, refined if set, from every node on options_t.threads workers and
+ * saves the best tour. Without time limit the result is the one of the sequential scan
+ * for any number of threads
+ * 
+ * @param inst 
+ * @param refine if true every greedy tour is refined with 2opt, alternated with Or-opt if set
+ * @return ERROR_CODE 
+ */
+static ERROR_CODE h_multistart(instance* inst, bool refine){
+    h_multistart_ctx ms;
+    ms.inst = inst;
+    ms.refine = refine;
+    ms.tree = NULL;
+    ms.next_start = 0;
+    ms.incumbent = __DBL_MAX__;
+
+    // the tree is built once here and forked by every worker
+    if(inst->costs_mode != COSTS_MATRIX){
+        ms.tree = tsp_points_tree(inst);
+        if(ms.tree == NULL){
+            return RESOURCE_EXHAUSTED;
+        }
+    }
+
+    int nthreads = tsp_costs_threads(inst);
+    if(nthreads > inst->nnodes){
+        nthreads = inst->nnodes;
+    }
+
+    ms.workers = (h_multistart_worker*) calloc(nthreads, sizeof(h_multistart_worker));
+    if(ms.workers == NULL){
+        return RESOURCE_EXHAUSTED;
+    }
+
     ERROR_CODE e = OK;
-    tsp_solution solution = tsp_init_solution(inst->nnodes);
+    for(int w=0; w<nthreads; w++){
+        ms.workers[w].best = tsp_init_solution(inst->nnodes);
+        ms.workers[w].start = -1;
+        ms.workers[w].e = OK;
+        if(ms.workers[w].best.path == NULL){
+            e = RESOURCE_EXHAUSTED;
+        }
+    }
 
-    for(int i=0; i<inst->nnodes; i++){
-        if(inst->options_t.timelimit != -1.0){
-            double ex_time = utils_timeelapsed(inst->c);
-            if(ex_time > inst->options_t.timelimit){
-                e = DEADLINE_EXCEEDED;
-                break;
+    if(e == OK){
+        log_debug("multi-start on %d threads", nthreads);
+        threads_run(nthreads, h_multistart_task, &ms);
+
+        // deterministic reduction: lowest cost, then smallest starting node
+        h_multistart_worker* best = NULL;
+        for(int w=0; w<nthreads; w++){
+            h_multistart_worker* cur = &ms.workers[w];
+            if(e == OK && cur->e != OK){
+                e = cur->e;
+            }
+            if(cur->start != -1 && (best == NULL || cur->best.cost < best->best.cost ||
+               (cur->best.cost == best->best.cost && cur->start < best->start))){
+                best = cur;
             }
         }
 
-        log_debug("starting greedy with node %d", i);
-        ERROR_CODE error = h_greedyutil(inst, i, solution.path, &solution.cost);
-        if(!err_ok(error)){
-            log_error("code %d : error in iteration %i of 2opt greedy", error, i);
-            break;
+        if(best != NULL){
+            ERROR_CODE error = tsp_update_best_solution(inst, &best->best);
+            if(error == OK){
+                log_info("found new best solution: starting node %d, cost %f", best->start, best->best.cost);
+                inst->starting_node = best->start;
+            }else if(!err_ok(error)){
+                log_error("code %d : error in updating best solution of multi-start", error);
+            }
         }
 
-        log_debug("greedy solution: cost: %f", solution.cost);
-
-        error = ref_2opt(inst, &solution);
-        if(!err_ok(error)){
-            log_error("code %d : error in 2opt", error);
-            break;
-        }else if (error == OK)
-        {
-            log_info("found new best solution: starting node %d, cost %f", i, inst->best_solution.cost);
-            inst->starting_node = i;
+        if(e == OK && deadline_stopped(&inst->deadline)){
+            e = DEADLINE_EXCEEDED;
         }
-        
     }
 
-    free(solution.path);
+    for(int w=0; w<nthreads; w++){
+        free(ms.workers[w].best.path);
+    }
+    free(ms.workers);
 
     return e;
 }
@@ -107,63 +329,123 @@ ERROR_CODE h_greedyutil(instance* inst, int starting_node, int* solution_path, d
         return UNAVAILABLE;
     }
 
+    // without a matrix the O(n^2) scan would go through the slow costs, as in h_multistart
+    if(inst->costs_mode != COSTS_MATRIX){
+        kdtree* tree = tsp_points_tree(inst);
+        if(tree == NULL){
+            log_error("code %d : cannot build the tree of the points", RESOURCE_EXHAUSTED);
+            return RESOURCE_EXHAUSTED;
+        }
+        return h_greedyutil_kdtree(inst, tree, starting_node, solution_path, solution_cost);
+    }
+
+    uint64_t* visited = (uint64_t*)malloc(h_visited_words(inst->nnodes) * sizeof(uint64_t));
+    if(visited == NULL){
+        return RESOURCE_EXHAUSTED;
+    }
+
+    ERROR_CODE e = h_greedy_matrix(inst, visited, starting_node, solution_path, solution_cost, __DBL_MAX__);
+
+    free(visited);
+
+    return e;
+}
+
+ERROR_CODE h_greedyutil_kdtree(instance* inst, kdtree* tree, int starting_node, int* solution_path, double* solution_cost){
+    if(starting_node >= inst->nnodes || starting_node < 0){
+        return UNAVAILABLE;
+    }
+
+    return h_greedy_tree(inst, tree, starting_node, solution_path, solution_cost, __DBL_MAX__);
+}
+
+static ERROR_CODE h_greedy_matrix(instance* inst, uint64_t* visited, int starting_node, int* solution_path, double* solution_cost, double bound){
     ERROR_CODE e = OK;
 
-    int* visited = (int*)calloc(inst->nnodes, sizeof(int));
+    memset(visited, 0, h_visited_words(inst->nnodes) * sizeof(uint64_t));
 
     int curr = starting_node;
-    visited[curr] = 1;
+    visited[curr >> 6] |= 1ULL << (curr & 63);
     
     double sol_cost = 0;
-    bool done = false;
 
-    while(!done){
+    int countdown = DEADLINE_PERIOD;
+    while(true){
         // check that we have not exceed time limit
-        double ex_time = utils_timeelapsed(inst->c);
-        if(inst->options_t.timelimit != -1.0){
-            if(ex_time > inst->options_t.timelimit){
-                e = DEADLINE_EXCEEDED;
-                break;
-            }
+        if(deadline_poll(&inst->deadline, &countdown, DEADLINE_PERIOD)){
+            e = DEADLINE_EXCEEDED;
+            break;
         }
 
-        // identify minimum distance from the current node
-        int min_idx = -1;
-        double min_dist = __DBL_MAX__;
-
-        for(int i=0; i<inst->nnodes; i++){
-            // skip iteration if it's already visited
-            if(i != curr && visited[i] != 1){
-                // update the minimum cost and its node
-                double temp = tsp_get_cost(inst, curr, i);
-                if(temp != NOT_CONNECTED && temp < min_dist){
-                    min_dist = temp;
-                    min_idx = i;
-                }
-            }
+        // identify minimum distance from the current node among the unvisited ones
+        double min_dist;
+        int min_idx = simd_argmin_unvisited(inst->costs + (size_t)curr * inst->nnodes, visited, inst->nnodes, &min_dist);
+        if(min_idx == -1){
+            // we have visited all nodes
+            break;
         }
 
-        // save the edge
+        // save the edge, mark the node as visited and update the cost of the solution
         solution_path[curr] = min_idx;
+        visited[min_idx >> 6] |= 1ULL << (min_idx & 63);
+        curr = min_idx;
+        sol_cost += min_dist;
 
-        if(min_idx == -1){
-            // we have visited all nodes
-            // close the path
-            solution_path[curr] = starting_node;
-            done = true;
-        }else{
-            // mark the node as visited and update the cost of the solution
-            visited[min_idx] = 1;
-            curr = min_idx;
-            sol_cost += min_dist;
+        // the partial tour already costs more than the bound
+        if(sol_cost > bound){
+            e = CANCELLED;
+            break;
         }
     }
 
-    // add last edge
+    // close the path
+    solution_path[curr] = starting_node;
     sol_cost += tsp_get_cost(inst, curr, starting_node);
     *(solution_cost) = sol_cost;
 
-    free(visited);
+    return e;
+}
+
+static ERROR_CODE h_greedy_tree(instance* inst, kdtree* tree, int starting_node, int* solution_path, double* solution_cost, double bound){
+    ERROR_CODE e = OK;
+
+    kd_restore(tree);
+
+    int curr = starting_node;
+    kd_delete(tree, curr);
+
+    double sol_cost = 0;
+
+    int countdown = DEADLINE_PERIOD;
+    while(true){
+        // check that we have not exceed time limit
+        if(deadline_poll(&inst->deadline, &countdown, DEADLINE_PERIOD)){
+            e = DEADLINE_EXCEEDED;
+            break;
+        }
+
+        // nearest node still in the tree, i.e. not visited
+        int next = kd_nearest(tree, inst->points[curr].x, inst->points[curr].y);
+        if(next == -1){
+            break;
+        }
+
+        solution_path[curr] = next;
+        sol_cost += tsp_get_cost(inst, curr, next);
+        kd_delete(tree, next);
+        curr = next;
+
+        // the partial tour already costs more than the bound
+        if(sol_cost > bound){
+            e = CANCELLED;
+            break;
+        }
+    }
+
+    // close the path
+    solution_path[curr] = starting_node;
+    sol_cost += tsp_get_cost(inst, curr, starting_node);
+    *(solution_cost) = sol_cost;
 
     return e;
 }
@@ -28,6 +28,7 @@ ERROR_CODE h_Greedy(instance *inst);
 
 /**
  * @brief Runs greedy iteratively on all nodes and picks the best solution
+ * The starting nodes are split among options_t.threads workers, the result does not depend on their number
  * 
  * @param inst 
  * @return ERROR_CODE 
@@ -36,18 +37,46 @@ ERROR_CODE h_Greedy_iterative(instance* inst);
 
 /**
  * @brief Runs greedy iteratively on all nodes and perform 2-opt on each solution until no improvement
+ * The starting nodes are split among options_t.threads workers, the result does not depend on their number
  * 
  * @param inst 
  * @return ERROR_CODE 
  */
 ERROR_CODE h_greedy_2opt(instance* inst);
 
+/**
+ * @brief Runs greedy from the starting node and refines the solution with 2-opt, a single start
+ * of h_greedy_2opt
+ * 
+ * @param inst 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE h_greedy_2opt_single(instance* inst);
+
+/**
+ * @brief Runs greedy from the starting node and refines the solution with 3-opt
+ * 
+ * @param inst 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE h_greedy_3opt(instance* inst);
+
+/**
+ * @brief Runs greedy from the starting node and refines the solution with Lin-Kernighan
+ * 
+ * @param inst 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE h_greedy_lk(instance* inst);
+
 //================================================================================
 // UTILS
 //================================================================================
 
 /**
- * @brief Solves with nearest neighbor heuristic starting from a fixed point
+ * @brief Solves with nearest neighbor heuristic starting from a fixed point.
+ * With the dense matrix each step is a vectorized scan of a cost row masked by a visited bitmap, with any other storage
+ * the nearest unvisited node comes from the k-d tree (h_greedyutil_kdtree)
  * 
  * @param inst 
  * @param starting_node 
@@ -55,4 +84,15 @@ ERROR_CODE h_greedy_2opt(instance* inst);
  */
 ERROR_CODE h_greedyutil(instance* inst, int starting_node, int* solution_path, double* solution_cost);
 
+/**
+ * @brief Nearest neighbor heuristic on the k-d tree of the points: visited nodes are
+ * deleted from the tree, so a tour costs O(n log n) and needs no cost matrix
+ * 
+ * @param inst 
+ * @param tree k-d tree over the points, restored before use
+ * @param starting_node 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE h_greedyutil_kdtree(instance* inst, kdtree* tree, int starting_node, int* solution_path, double* solution_cost);
+
 #endif
@@ -32,7 +32,7 @@ ERROR_CODE tabu_random_policy(tabu_search* t){
         return ALREADY_EXISTS;
     }
 
-    t->tenure = (int)(rand() / RAND_MAX) * (t->max_tenure - t->min_tenure) + t->min_tenure;
+    t->tenure = t->min_tenure + rng_int(&t->rng, t->max_tenure - t->min_tenure + 1);
 
     return OK;
 }
@@ -58,6 +58,49 @@ ERROR_CODE tabu_linear_policy(tabu_search* ts){
     return OK;
 }
 
+static int tabu_history_find(const tabu_history* h, uint64_t hash);
+static ERROR_CODE tabu_history_insert(tabu_history* h, uint64_t hash, int current_iteration);
+static ERROR_CODE tabu_kick(instance* inst, tour* t, double* solution_cost, tabu_search* ts);
+
+bool tabu_reactive_policy(tabu_search* ts, tabu_history* h, int current_iteration){
+    int slot = tabu_history_find(h, h->hash);
+
+    if(h->seen[slot] == h->hash){
+        int cycle = current_iteration - h->last_visit[slot];
+        h->last_visit[slot] = current_iteration;
+        h->visits[slot]++;
+
+        // a tour seen too often means the search is trapped in a chaotic attractor
+        if(h->visits[slot] > TABU_REPETITIONS){
+            h->chaotic++;
+            if(h->chaotic > TABU_CHAOTIC){
+                h->chaotic = 0;
+                return true;
+            }
+        }
+
+        // a repetition asks for a longer tenure
+        h->cycle_length = 0.1 * cycle + 0.9 * h->cycle_length;
+        int tenure = (int)(ts->tenure * TABU_INCREASE);
+        ts->tenure = tenure > ts->tenure ? tenure : ts->tenure + 1;
+        if(ts->tenure > ts->max_tenure){
+            ts->tenure = ts->max_tenure;
+        }
+        h->last_change = current_iteration;
+    }else if(!err_ok(tabu_history_insert(h, h->hash, current_iteration))){
+        log_warn("cannot grow the table of visited tours");
+    }
+
+    // no repetition for longer than a cycle, the tenure can shrink
+    if(current_iteration - h->last_change > h->cycle_length){
+        int tenure = (int)(ts->tenure * TABU_DECREASE);
+        ts->tenure = tenure < 1 ? 1 : tenure;
+        h->last_change = current_iteration;
+    }
+
+    return false;
+}
+
 //================================================================================
 // TABU SEARCH
 //================================================================================
@@ -67,12 +110,22 @@ ERROR_CODE tabu_init(tabu_search* ts, int nnodes, POLICIES policy){
     ts->policy = policy;
 
     ts->tabu_list = (int*) calloc(nnodes, sizeof(int));
+    ts->forbidden = (char*) calloc(nnodes, sizeof(char));
+    if(ts->tabu_list == NULL || ts->forbidden == NULL){
+        tabu_free(ts);
+        return RESOURCE_EXHAUSTED;
+    }
     for(int i=0; i< nnodes; i++){
         ts->tabu_list[i] = -1;
     }
 
     ts->increment = true;
 
+    for(int i=0; i<4; i++){
+        ts->last_move[i] = -1;
+    }
+    rng_seed(&ts->rng, 0);
+
     ts->tenure = MIN_FRACTION * nnodes + 1;
 
     // initialize min and max tenure
@@ -83,70 +136,287 @@ ERROR_CODE tabu_init(tabu_search* ts, int nnodes, POLICIES policy){
     
 }
 
-ERROR_CODE mh_TabuSearch(instance* inst, POLICIES policy){
-    // initialize
-    tabu_search ts;
-    if(!err_ok(tabu_init(&ts, inst->nnodes, policy))){
-        log_fatal("code %d : Error in init tabu search"); 
-        tsp_handlefatal(inst);
+/**
+ * @brief Tenure update before each move, as set by the policy
+ */
+static ERROR_CODE tabu_update_tenure(tabu_search* ts){
+    switch(ts->policy){
+        case POL_SIZE:
+            return tabu_dependent_policy(ts);
+        case POL_RANDOM:
+            return tabu_random_policy(ts);
+        case POL_LINEAR:
+            return tabu_linear_policy(ts);
+        default:
+            // fixed tenure is set by tabu_init, the reactive one changes after each move
+            return OK;
     }
+}
 
-    ERROR_CODE e = OK;
+/**
+ * @brief Walker of the parallel tabu search
+ */
+typedef struct {
+    rng_state rng;              // random stream of the walker
+    ERROR_CODE e;
+} tabu_walker;
+
+/**
+ * @brief State shared by the walkers of tabu search. The best tour of the instance is guarded
+ * by lock; its cost is mirrored in incumbent, read without the lock so that a walker takes it
+ * only when it has a better tour or needs a restart
+ */
+typedef struct {
+    instance* inst;
+    POLICIES policy;            // policy of walker 0, walker w takes the w-th one after it
+    pthread_mutex_t lock;       // guards inst->best_solution
+    double incumbent;           // cost of inst->best_solution
+    tabu_walker* walkers;
+} tabu_walkers;
+
+/**
+ * @brief Saves the tour as the best one if it is still better than the incumbent
+ */
+static ERROR_CODE tabu_walkers_publish(tabu_walkers* tw, tour* t, tsp_solution* solution){
+    double incumbent;
+    __atomic_load(&tw->incumbent, &incumbent, __ATOMIC_ACQUIRE);
+    if(solution->cost >= incumbent){
+        return CANCELLED;
+    }
 
-    // file to hold solution value in each iteration
-    FILE* f = fopen("results/TabuResults.dat", "w+");
+    ERROR_CODE e = CANCELLED;
+    pthread_mutex_lock(&tw->lock);
+    if(solution->cost < tw->inst->best_solution.cost){
+        tour_to_successors(t, solution->path);
+        e = tsp_update_best_solution(tw->inst, solution);
+        if(e == OK){
+            __atomic_store(&tw->incumbent, &solution->cost, __ATOMIC_RELEASE);
+        }
+    }
+    pthread_mutex_unlock(&tw->lock);
 
-    tsp_solution solution = tsp_init_solution(inst->nnodes);
+    return e;
+}
 
-    // get a solution with an heuristic algorithm
+/**
+ * @brief Copies the best tour into the walker
+ */
+static void tabu_walkers_fetch(tabu_walkers* tw, tour* t, tsp_solution* solution){
+    pthread_mutex_lock(&tw->lock);
+    memcpy(solution->path, tw->inst->best_solution.path, tw->inst->nnodes * sizeof(int));
+    solution->cost = tw->inst->best_solution.cost;
+    pthread_mutex_unlock(&tw->lock);
 
-    if(!err_ok(h_greedy_2opt(inst))){
-        log_fatal("code %d : Error in greedy solution computation");
-        tsp_handlefatal(inst);
-        free(solution.path);
-    }
+    tour_from_successors(t, solution->path);
+}
 
-    solution.cost = inst->best_solution.cost;
-    memcpy(solution.path, inst->best_solution.path, inst->nnodes * sizeof(int));
-    log_debug("2opt greedy sol cost: %f", solution.cost);
+static void tabu_walk(void* ctx, int thread_id, int nthreads){
+    (void) nthreads;
+    tabu_walkers* tw = (tabu_walkers*) ctx;
+    instance* inst = tw->inst;
+    tabu_walker* w = &tw->walkers[thread_id];
+
+    POLICIES policy = (POLICIES)((tw->policy + thread_id) % (POL_REACTIVE + 1));
+    int restart = inst->options_t.tabu_restart;
+    // with candidate lists the best move comes from the incremental cache instead of a full scan
+    bool cached = inst->candidates.type != CAND_NONE;
+
+    // per-walker state, the zeroed structs are safe to free if an allocation fails
+    tabu_search ts;
+    tour t;
+    tabu_cache tc;
+    tabu_history history;
+    memset(&ts, 0, sizeof(ts));
+    memset(&t, 0, sizeof(t));
+    memset(&tc, 0, sizeof(tc));
+    memset(&history, 0, sizeof(history));
+    tsp_solution solution = tsp_init_solution(inst->nnodes);
+
+    if(solution.path == NULL || !err_ok(tabu_init(&ts, inst->nnodes, policy)) || !err_ok(tour_init(&t, inst->nnodes)) ||
+       (cached && !err_ok(tabu_cache_init(&tc, inst->nnodes)))){
+        log_error("code %d : cannot allocate tabu walker %d", RESOURCE_EXHAUSTED, thread_id);
+        w->e = RESOURCE_EXHAUSTED;
+    }
+    ts.rng = w->rng;
+
+    // file to hold solution value in each iteration, for the plot of the first walker
+    FILE* f = NULL;
+    if(w->e == OK){
+        tabu_walkers_fetch(tw, &t, &solution);
+        if(thread_id == 0){
+            f = fopen("results/TabuResults.dat", "w+");
+        }else{
+            // the other walkers start from a kick of the tour, so that equal policies diverge
+            w->e = tabu_kick(inst, &t, &solution.cost, &ts);
+        }
+    }
+    if(w->e == OK && policy == POL_REACTIVE && !err_ok(tabu_history_init(&history, &t))){
+        log_error("code %d : cannot allocate the history of tabu walker %d", RESOURCE_EXHAUSTED, thread_id);
+        w->e = RESOURCE_EXHAUSTED;
+    }
+    double walker_best = solution.cost;
 
     // tabu search with 2opt moves
-    for(int k=0; k < inst->options_t.k; k++){
+    for(int k=0; w->e == OK && k < inst->options_t.k; k++){
 
         // check if exceeds time
-        double ex_time = utils_timeelapsed(inst->c);
-        if(inst->options_t.timelimit != -1.0){
-            if(ex_time > inst->options_t.timelimit){
-                e = DEADLINE_EXCEEDED;
+        if(deadline_expired(&inst->deadline)){
+            break;
+        }
+
+        // a walker that did not reach the best tour since its last restart starts again from it
+        bool restarted = false;
+        if(restart > 0 && k > 0 && k % restart == 0){
+            double incumbent;
+            __atomic_load(&tw->incumbent, &incumbent, __ATOMIC_ACQUIRE);
+            if(walker_best > incumbent){
+                log_debug("tabu walker %d restarts from the best tour, cost %f", thread_id, incumbent);
+                tabu_walkers_fetch(tw, &t, &solution);
+                walker_best = solution.cost;
+                for(int i=0; i<inst->nnodes; i++){
+                    ts.tabu_list[i] = -1;
+                }
+                if(policy == POL_REACTIVE){
+                    tabu_history_rehash(&history, &t);
+                }
+                restarted = true;
             }
         }
 
-        // update tenure
-        ERROR_CODE e = tabu_linear_policy(&ts);
+        // update tenure, the reactive policy updates it after the move
+        ERROR_CODE e = tabu_update_tenure(&ts);
         if(!err_ok(e)){
             log_warn("using already set policy %d", ts.policy);
         }
 
         // 2opt move
-        e = tabu_best_move(inst, solution.path, &solution.cost, &ts, k);
-        if(!err_ok(e)){
-            log_fatal("code %d : Error in tabu best move", e); 
-            tsp_handlefatal(inst);
-            free(solution.path);
+        if(cached){
+            // reversed segments change which edges pair up across their ends, entries are
+            // fixed lazily for the top of the heap and rebuilt for every node once in a while
+            if(k % inst->nnodes == 0 || restarted){
+                tabu_cache_build(inst, &t, &ts, &tc, k);
+            }
+            e = tabu_cached_move(inst, &t, &solution.cost, &ts, &tc, k);
+        }else{
+            e = tabu_best_move(inst, &t, &solution.cost, &ts, k);
         }
 
-        e = tsp_update_best_solution(inst, &solution);
+        // revisited tours drive the tenure, a trapped search escapes with random kicks
+        if(policy == POL_REACTIVE && err_ok(e) && ts.last_move[0] != -1){
+            tabu_history_move(&history, &ts);
+            if(tabu_reactive_policy(&ts, &history, k)){
+                e = tabu_escape(inst, &t, &solution.cost, &ts, &history);
+                if(err_ok(e) && cached){
+                    tabu_cache_build(inst, &t, &ts, &tc, k + 1);
+                }
+            }
+        }
         if(!err_ok(e)){
-            log_fatal("code %d : Error in updating best solution", e); 
-            tsp_handlefatal(inst);
-            free(solution.path);
+            log_error("code %d : error in tabu best move of walker %d", e, thread_id);
+            w->e = e;
+            break;
+        }
+
+        // the successor array is needed only for a new best
+        if(solution.cost < walker_best){
+            walker_best = solution.cost;
+            e = tabu_walkers_publish(tw, &t, &solution);
+            if(!err_ok(e)){
+                log_error("code %d : error in updating best solution of walker %d", e, thread_id);
+                w->e = e;
+                break;
+            }
+        }
+
+        // the first walker saves the best tour under the lock that guards it, checking the interval
+        // at every iteration since an iteration without candidate lists is a full O(n^2) scan
+        if(thread_id == 0){
+            double incumbent;
+            __atomic_load(&tw->incumbent, &incumbent, __ATOMIC_ACQUIRE);
+            if(tsp_checkpoint_due(inst, incumbent)){
+                pthread_mutex_lock(&tw->lock);
+                tsp_checkpoint(inst, inst->best_solution.path, inst->best_solution.cost);
+                pthread_mutex_unlock(&tw->lock);
+            }
         }
 
         // save current iteration and current solution cost to file for the plot
-        fprintf(f, "%d,%f\n", k, solution.cost);
+        if(f != NULL){
+            fprintf(f, "%d,%f\n", k, solution.cost);
+        }
     }
 
-    fclose(f);
+    if(f != NULL){
+        fclose(f);
+    }
+
+    free(solution.path);
+    tour_free(&t);
+    tabu_free(&ts);
+    if(cached){
+        tabu_cache_free(&tc);
+    }
+    if(policy == POL_REACTIVE){
+        tabu_history_free(&history);
+    }
+}
+
+ERROR_CODE mh_TabuSearch(instance* inst, POLICIES policy){
+    // start from the tour given with -init or, without it, from a solution of an heuristic algorithm
+    if(tsp_warm_start(inst) != OK){
+        if(!err_ok(h_greedy_2opt(inst))){
+            log_fatal("code %d : Error in greedy solution computation");
+            tsp_handlefatal(inst);
+        }
+        log_debug("2opt greedy sol cost: %f", inst->best_solution.cost);
+    }
+
+    // walkers share the cost storage, so they are bound by the threads it allows
+    int nwalkers = inst->options_t.tabu_walkers;
+    int nthreads = tsp_costs_threads(inst);
+    if(nwalkers > nthreads){
+        log_warn("%d tabu walkers, the costs allow only %d threads", nwalkers, nthreads);
+        nwalkers = nthreads;
+    }
+
+    tabu_walkers tw;
+    tw.inst = inst;
+    tw.policy = policy;
+    tw.incumbent = inst->best_solution.cost;
+    tw.walkers = (tabu_walker*) calloc(nwalkers, sizeof(tabu_walker));
+    if(tw.walkers == NULL || pthread_mutex_init(&tw.lock, NULL) != 0){
+        free(tw.walkers);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    // disjoint streams jumped from the one of the instance, so a run depends only on -seed and the walkers
+    for(int w=0; w<nwalkers; w++){
+        rng_stream(&tw.walkers[w].rng, &inst->rng, w);
+        tw.walkers[w].e = OK;
+    }
+
+    log_debug("tabu search with %d walkers", nwalkers);
+    threads_run(nwalkers, tabu_walk, &tw);
+
+    ERROR_CODE e = OK;
+    for(int w=0; w<nwalkers; w++){
+        if(e == OK && tw.walkers[w].e != OK){
+            e = tw.walkers[w].e;
+        }
+    }
+    if(e == OK && deadline_stopped(&inst->deadline)){
+        e = DEADLINE_EXCEEDED;
+    }
+
+    pthread_mutex_destroy(&tw.lock);
+    free(tw.walkers);
+
+    if(!err_ok(e)){
+        log_fatal("code %d : Error in tabu search", e);
+        tsp_handlefatal(inst);
+    }
+
+    tsp_checkpoint(inst, inst->best_solution.path, inst->best_solution.cost);
 
     // plot the solution progression during iterations
     PLOT plot = plot_open("TabuIterationsPlot");
@@ -158,60 +428,41 @@ ERROR_CODE mh_TabuSearch(instance* inst, POLICIES policy){
     plot_stats(plot, "results/TabuResults.dat");
     plot_free(plot);
 
-    // free resources
-    free(solution.path);
-    tabu_free(&ts);
-
     return e;
 
 }
 
-ERROR_CODE tabu_best_move(instance* inst, int* solution_path, double* solution_cost, tabu_search* ts, int current_iteration){
-    double best_delta = __DBL_MAX__;
-    int best_swap[2] = {-1, -1};
-
-    int *prev = (int*)calloc(inst->nnodes, sizeof(int));          // save the path of the solution without 2opt
-    for (int i = 0; i < inst->nnodes; i++) {
-        prev[solution_path[i]] = i;
-    }
+ERROR_CODE tabu_best_move(instance* inst, tour* t, double* solution_cost, tabu_search* ts, int current_iteration){
+    ts->last_move[0] = -1;
 
-    // scan nodes to find best swap
-    for (int a = 0; a < inst->nnodes - 1; a++) {
-        for (int b = a+1; b < inst->nnodes; b++) {
-            int succ_a = solution_path[a]; //successor of a
-            int succ_b = solution_path[b]; //successor of b
-            
-            // Skip non valid configurations
-            if (succ_a == succ_b || a == succ_b || b == succ_a){
-                continue;
-            }
+    const int* solution_path = tour_successors(t);
 
-            if(is_in_tabu_list(ts, a, current_iteration) || is_in_tabu_list(ts, b, current_iteration) || is_in_tabu_list(ts, succ_a, current_iteration) || is_in_tabu_list(ts, succ_b, current_iteration)){ 
-                continue; 
-            }
-
-            // Compute the delta
-            double current_cost = tsp_get_cost(inst, a, succ_a) + tsp_get_cost(inst, b, succ_b);
-            double swapped_cost = tsp_get_cost(inst, a, b) + tsp_get_cost(inst, succ_a, succ_b);
-            double delta = swapped_cost - current_cost;
-            if (delta < best_delta) {
-                best_delta = delta;
-                best_swap[0] = a;
-                best_swap[1] = b;
-            }
-        }
+    // the tabu test is done once per node, not once per pair
+    bool any_tabu = false;
+    for(int i=0; i<inst->nnodes; i++){
+        ts->forbidden[i] = is_in_tabu_list(ts, i, current_iteration);
+        any_tabu |= ts->forbidden[i];
     }
 
+    // best move among the non tabu ones, even if it worsens the solution;
+    // without tabu nodes the scan takes the vectorized path
+    ref_2opt_move best = ref_2opt_scan(inst, solution_path, any_tabu ? ts->forbidden : NULL, __DBL_MAX__);
+
     // execute best swap
-    if(best_delta < __DBL_MAX__){    
-        int a = best_swap[0];
-        int b = best_swap[1];
-        log_debug("iteration %d: best swap is %d, %d with delta=%f", current_iteration, a, b, best_delta);
+    if(best.a != -1){
+        int a = best.a;
+        int b = best.b;
+        log_debug("iteration %d: best swap is %d, %d with delta=%f", current_iteration, a, b, best.delta);
         int succ_a = solution_path[a]; //successor of a
         int succ_b = solution_path[b]; //successor of b
 
-        ref_reverse_path(inst, a, succ_a, b, succ_b, prev, solution_path);
-        *solution_cost += best_delta;
+        tour_2opt_move(t, a, b);
+        *solution_cost += best.delta;
+
+        ts->last_move[0] = a;
+        ts->last_move[1] = succ_a;
+        ts->last_move[2] = b;
+        ts->last_move[3] = succ_b;
 
         // update tabu list
         ts->tabu_list[a] = current_iteration;
@@ -220,7 +471,372 @@ ERROR_CODE tabu_best_move(instance* inst, int* solution_path, double* solution_c
         ts->tabu_list[succ_b] = current_iteration;
     }
 
-    free(prev);
+    return OK;
+}
+
+//================================================================================
+// TABU HISTORY
+//================================================================================
+
+/**
+ * @brief Key of the undirected edge u-v: the pair hashed with the splitmix64 finalizer,
+ * instead of a random table that would need n^2 entries
+ */
+static inline uint64_t tabu_edge_key(int u, int v){
+    uint64_t x = u < v ? ((uint64_t) u << 32) | (uint32_t) v : ((uint64_t) v << 32) | (uint32_t) u;
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+}
+
+/**
+ * @brief Slot of hash, or the empty slot where it would go
+ */
+static int tabu_history_find(const tabu_history* h, uint64_t hash){
+    int slot = (int)(hash & (uint64_t)(h->capacity - 1));
+    while(h->seen[slot] != 0 && h->seen[slot] != hash){
+        slot = (slot + 1) & (h->capacity - 1);
+    }
+    return slot;
+}
+
+static ERROR_CODE tabu_history_alloc(tabu_history* h, int capacity){
+    h->capacity = capacity;
+    h->size = 0;
+    h->seen = (uint64_t*) calloc(capacity, sizeof(uint64_t));
+    h->last_visit = (int*) malloc(capacity * sizeof(int));
+    h->visits = (int*) malloc(capacity * sizeof(int));
+    if(h->seen == NULL || h->last_visit == NULL || h->visits == NULL){
+        tabu_history_free(h);
+        return RESOURCE_EXHAUSTED;
+    }
+    return OK;
+}
+
+static ERROR_CODE tabu_history_insert(tabu_history* h, uint64_t hash, int current_iteration){
+    // at half load the table doubles
+    if(2 * (h->size + 1) > h->capacity){
+        tabu_history old = *h;
+        if(!err_ok(tabu_history_alloc(h, 2 * old.capacity))){
+            *h = old;
+            return RESOURCE_EXHAUSTED;
+        }
+        for(int i=0; i<old.capacity; i++){
+            if(old.seen[i] != 0){
+                int slot = tabu_history_find(h, old.seen[i]);
+                h->seen[slot] = old.seen[i];
+                h->last_visit[slot] = old.last_visit[i];
+                h->visits[slot] = old.visits[i];
+                h->size++;
+            }
+        }
+        tabu_history_free(&old);
+    }
+
+    int slot = tabu_history_find(h, hash);
+    h->seen[slot] = hash;
+    h->last_visit[slot] = current_iteration;
+    h->visits[slot] = 1;
+    h->size++;
+
+    return OK;
+}
+
+ERROR_CODE tabu_history_init(tabu_history* h, tour* t){
+    if(!err_ok(tabu_history_alloc(h, TABU_HISTORY_SLOTS))){
+        return RESOURCE_EXHAUSTED;
+    }
+
+    h->cycle_length = 1;
+    h->last_change = 0;
+    h->chaotic = 0;
+    tabu_history_rehash(h, t);
+
+    return OK;
+}
+
+void tabu_history_rehash(tabu_history* h, tour* t){
+    const int* succ = tour_successors(t);
+    h->hash = 0;
+    for(int i=0; i<t->nnodes; i++){
+        h->hash ^= tabu_edge_key(i, succ[i]);
+    }
+
+    // 0 marks the empty slots
+    if(h->hash == 0){
+        h->hash = 1;
+    }
+}
+
+void tabu_history_move(tabu_history* h, tabu_search* ts){
+    const int* m = ts->last_move;
+    if(m[0] == -1){
+        return;
+    }
+
+    h->hash ^= tabu_edge_key(m[0], m[1]) ^ tabu_edge_key(m[2], m[3]) ^ tabu_edge_key(m[0], m[2]) ^ tabu_edge_key(m[1], m[3]);
+    if(h->hash == 0){
+        h->hash = 1;
+    }
+}
+
+/**
+ * @brief Kick of VNS on four distinct nodes drawn from the random stream of the walker
+ */
+static ERROR_CODE tabu_kick(instance* inst, tour* t, double* solution_cost, tabu_search* ts){
+    // too small to have four edges to exchange
+    if(inst->nnodes < 8){
+        return OK;
+    }
+
+    int nodes[4];
+    nodes[0] = rng_int(&ts->rng, inst->nnodes);
+    do { nodes[1] = rng_int(&ts->rng, inst->nnodes); } while(nodes[1] == nodes[0]);
+    do { nodes[2] = rng_int(&ts->rng, inst->nnodes); } while(nodes[2] == nodes[0] || nodes[2] == nodes[1]);
+    do { nodes[3] = rng_int(&ts->rng, inst->nnodes); } while(nodes[3] == nodes[0] || nodes[3] == nodes[1] || nodes[3] == nodes[2]);
+
+    return vns_kick_at(inst, t, solution_cost, nodes, NULL);
+}
+
+ERROR_CODE tabu_escape(instance* inst, tour* t, double* solution_cost, tabu_search* ts, tabu_history* h){
+    // as many random steps as half a cycle, at least one
+    int steps = 1 + (int)((1.0 + rng_double(&ts->rng)) * h->cycle_length / 2);
+    if(steps > inst->nnodes){
+        steps = inst->nnodes;
+    }
+    log_debug("escape with %d random kicks", steps);
+
+    for(int i=0; i<steps; i++){
+        ERROR_CODE e = tabu_kick(inst, t, solution_cost, ts);
+        if(!err_ok(e)){
+            return e;
+        }
+    }
+
+    for(int i=0; i<inst->nnodes; i++){
+        ts->tabu_list[i] = -1;
+    }
+    ts->last_move[0] = -1;
+    tabu_history_rehash(h, t);
+
+    return OK;
+}
+
+//================================================================================
+// TABU MOVE CACHE
+//================================================================================
+
+static inline bool tabu_heap_less(const tabu_cache* tc, int x, int y){
+    return tc->delta[x] < tc->delta[y] || (tc->delta[x] == tc->delta[y] && x < y);
+}
+
+static inline void tabu_heap_place(tabu_cache* tc, int i, int node){
+    tc->heap[i] = node;
+    tc->pos[node] = i;
+}
+
+static void tabu_heap_sift(tabu_cache* tc, int i){
+    int node = tc->heap[i];
+
+    // up
+    while(i > 0 && tabu_heap_less(tc, node, tc->heap[(i - 1) / 2])){
+        tabu_heap_place(tc, i, tc->heap[(i - 1) / 2]);
+        i = (i - 1) / 2;
+    }
+
+    // down
+    while(true){
+        int child = 2 * i + 1;
+        if(child >= tc->nnodes){
+            break;
+        }
+        if(child + 1 < tc->nnodes && tabu_heap_less(tc, tc->heap[child + 1], tc->heap[child])){
+            child++;
+        }
+        if(!tabu_heap_less(tc, tc->heap[child], node)){
+            break;
+        }
+        tabu_heap_place(tc, i, tc->heap[child]);
+        i = child;
+    }
+
+    tabu_heap_place(tc, i, node);
+}
+
+/**
+ * @brief Best non tabu 2opt move that joins a to one of its candidates, on either side of a
+ */
+static void tabu_cache_eval(instance* inst, tour* t, tabu_search* ts, tabu_cache* tc, int a, int current_iteration){
+    tc->delta[a] = __DBL_MAX__;
+    tc->stamp[a] = current_iteration;
+    if(is_in_tabu_list(ts, a, current_iteration)){
+        return;
+    }
+
+    const candidate_list* cl = &inst->candidates;
+    const int* neighbors = cand_neighbors(cl, a);
+    int count = cand_count(cl, a);
+
+    for(int forward = 1; forward >= 0; forward--){
+        int a2 = forward ? tour_next(t, a) : tour_prev(t, a);
+        if(is_in_tabu_list(ts, a2, current_iteration)){
+            continue;
+        }
+        double removed_a = tsp_get_cost(inst, a, a2);
+
+        for(int k=0; k<count; k++){
+            int c = neighbors[k];
+            int c2 = forward ? tour_next(t, c) : tour_prev(t, c);
+            if(c == a2 || c2 == a || is_in_tabu_list(ts, c, current_iteration) || is_in_tabu_list(ts, c2, current_iteration)){
+                continue;
+            }
+
+            double delta = tsp_get_cost(inst, a, c) + tsp_get_cost(inst, a2, c2) - removed_a - tsp_get_cost(inst, c, c2);
+            if(delta < tc->delta[a]){
+                tc->delta[a] = delta;
+                tc->other[a] = c;
+                tc->forward[a] = (char) forward;
+            }
+        }
+    }
+}
+
+static void tabu_cache_refresh(instance* inst, tour* t, tabu_search* ts, tabu_cache* tc, int a, int current_iteration){
+    tabu_cache_eval(inst, t, ts, tc, a, current_iteration);
+    tabu_heap_sift(tc, tc->pos[a]);
+}
+
+static ERROR_CODE tabu_cache_expire_push(tabu_cache* tc, int node, int current_iteration){
+    if(tc->expiring_size == tc->expiring_capacity){
+        int capacity = 2 * tc->expiring_capacity;
+        int* expiring = (int*) malloc(capacity * sizeof(int));
+        int* since = (int*) malloc(capacity * sizeof(int));
+        if(expiring == NULL || since == NULL){
+            free(expiring);
+            free(since);
+            return RESOURCE_EXHAUSTED;
+        }
+        for(int i=0; i<tc->expiring_size; i++){
+            int j = (tc->expiring_head + i) % tc->expiring_capacity;
+            expiring[i] = tc->expiring[j];
+            since[i] = tc->expiring_since[j];
+        }
+        free(tc->expiring);
+        free(tc->expiring_since);
+        tc->expiring = expiring;
+        tc->expiring_since = since;
+        tc->expiring_head = 0;
+        tc->expiring_capacity = capacity;
+    }
+
+    int j = (tc->expiring_head + tc->expiring_size) % tc->expiring_capacity;
+    tc->expiring[j] = node;
+    tc->expiring_since[j] = current_iteration;
+    tc->expiring_size++;
+
+    return OK;
+}
+
+ERROR_CODE tabu_cache_init(tabu_cache* tc, int nnodes){
+    tc->nnodes = nnodes;
+    tc->heap = (int*) malloc(nnodes * sizeof(int));
+    tc->pos = (int*) malloc(nnodes * sizeof(int));
+    tc->delta = (double*) malloc(nnodes * sizeof(double));
+    tc->other = (int*) malloc(nnodes * sizeof(int));
+    tc->forward = (char*) malloc(nnodes * sizeof(char));
+    tc->stamp = (int*) malloc(nnodes * sizeof(int));
+    tc->expiring_capacity = 64;
+    tc->expiring = (int*) malloc(tc->expiring_capacity * sizeof(int));
+    tc->expiring_since = (int*) malloc(tc->expiring_capacity * sizeof(int));
+    tc->expiring_head = 0;
+    tc->expiring_size = 0;
+
+    if(tc->heap == NULL || tc->pos == NULL || tc->delta == NULL || tc->other == NULL || tc->forward == NULL ||
+       tc->stamp == NULL || tc->expiring == NULL || tc->expiring_since == NULL){
+        tabu_cache_free(tc);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    return OK;
+}
+
+void tabu_cache_build(instance* inst, tour* t, tabu_search* ts, tabu_cache* tc, int current_iteration){
+    for(int a=0; a<tc->nnodes; a++){
+        tabu_cache_eval(inst, t, ts, tc, a, current_iteration);
+        tabu_heap_place(tc, a, a);
+    }
+
+    for(int i=tc->nnodes / 2 - 1; i>=0; i--){
+        tabu_heap_sift(tc, i);
+    }
+}
+
+ERROR_CODE tabu_cached_move(instance* inst, tour* t, double* solution_cost, tabu_search* ts, tabu_cache* tc, int current_iteration){
+    ts->last_move[0] = -1;
+
+    // nodes that left the tabu list may have moves again
+    while(tc->expiring_size > 0){
+        int node = tc->expiring[tc->expiring_head];
+        int since = tc->expiring_since[tc->expiring_head];
+        if(current_iteration - since < ts->tenure){
+            break;
+        }
+        tc->expiring_head = (tc->expiring_head + 1) % tc->expiring_capacity;
+        tc->expiring_size--;
+
+        // a later entry exists if the node was made tabu again
+        if(!is_in_tabu_list(ts, node, current_iteration)){
+            tabu_cache_refresh(inst, t, ts, tc, node, current_iteration);
+
+            // moves blocked only by this node are allowed again, candidate lists are nearly symmetric
+            tabu_cache_refresh(inst, t, ts, tc, tour_next(t, node), current_iteration);
+            tabu_cache_refresh(inst, t, ts, tc, tour_prev(t, node), current_iteration);
+            const int* neighbors = cand_neighbors(&inst->candidates, node);
+            for(int k=0; k<cand_count(&inst->candidates, node); k++){
+                tabu_cache_refresh(inst, t, ts, tc, neighbors[k], current_iteration);
+            }
+        }
+    }
+
+    // stale entries are recomputed until the top of the heap is up to date
+    int a = tc->heap[0];
+    while(tc->stamp[a] != current_iteration && tc->delta[a] < __DBL_MAX__){
+        tabu_cache_refresh(inst, t, ts, tc, a, current_iteration);
+        a = tc->heap[0];
+    }
+
+    if(tc->delta[a] == __DBL_MAX__){
+        log_debug("iteration %d: every move is tabu", current_iteration);
+        return OK;
+    }
+
+    int c = tc->other[a];
+    int a2 = tc->forward[a] ? tour_next(t, a) : tour_prev(t, a);
+    int c2 = tc->forward[a] ? tour_next(t, c) : tour_prev(t, c);
+    double delta = tc->delta[a];
+    log_debug("iteration %d: best swap is %d, %d with delta=%f", current_iteration, a, c, delta);
+
+    // (a, a2), (c, c2) become (a, c), (a2, c2)
+    if(tc->forward[a]){
+        tour_2opt_move(t, a, c);
+    }else{
+        tour_2opt_move(t, a2, c2);
+    }
+    *solution_cost += delta;
+
+    // update tabu list, the endpoints are the only nodes whose tour edges changed
+    int endpoints[4] = {a, a2, c, c2};
+    for(int i=0; i<4; i++){
+        ts->last_move[i] = endpoints[i];
+        ts->tabu_list[endpoints[i]] = current_iteration;
+        if(!err_ok(tabu_cache_expire_push(tc, endpoints[i], current_iteration))){
+            return RESOURCE_EXHAUSTED;
+        }
+    }
+    for(int i=0; i<4; i++){
+        tabu_cache_refresh(inst, t, ts, tc, endpoints[i], current_iteration + 1);
+    }
 
     return OK;
 }
@@ -229,24 +845,233 @@ ERROR_CODE tabu_best_move(instance* inst, int* solution_path, double* solution_c
 // VARIABLE NEIGHBORHOOD SEARCH
 //================================================================================
 
+static const char* vns_names[] = {"2opt", "3opt", "Lin-Kernighan", "Or-opt"};
+
+/**
+ * @brief CPU time in milliseconds
+ */
+static double vns_cpu_ms(void){
+    return (double) clock() * 1000.0 / CLOCKS_PER_SEC;
+}
+
+ERROR_CODE vns_descent_init(instance* inst, vns_descent* vd){
+    memset(vd, 0, sizeof(vns_descent));
+    vd->adaptive = inst->options_t.vns_adaptive;
+    rng_stream(&vd->rng, &inst->rng, 0);
+
+    local_search types[VNS_MAX_NEIGHBORHOODS];
+    int count = inst->options_t.vns_count;
+    if(count > 0){
+        memcpy(types, inst->options_t.vns_neighborhoods, count * sizeof(local_search));
+    }else{
+        types[count++] = inst->options_t.vns_ls;
+        if(inst->options_t.oropt){
+            types[count++] = LS_OROPT;
+        }
+    }
+
+    if(!err_ok(ref_queue_init(&vd->changed, inst->nnodes))){
+        return RESOURCE_EXHAUSTED;
+    }
+
+    for(int k=0; k<count; k++){
+        vns_neighborhood* nb = &vd->neighborhoods[k];
+        nb->type = types[k];
+        switch(nb->type){
+            case LS_3OPT:
+                nb->search = ref_3opt_queue;
+                break;
+            case LS_LK:
+                nb->search = ref_lk_queue;
+                break;
+            case LS_OROPT:
+                nb->search = ref_oropt_queue;
+                break;
+            default:
+                nb->search = inst->options_t.twoopt == TWOOPT_BEST ? ref_2opt_best_queue : ref_2opt_queue;
+                break;
+        }
+
+        if(!err_ok(ref_queue_init(&nb->queue, inst->nnodes))){
+            vns_descent_free(vd);
+            return RESOURCE_EXHAUSTED;
+        }
+        vd->count++;
+    }
+
+    return OK;
+}
+
+void vns_descent_all(vns_descent* vd, tour* t){
+    for(int k=0; k<vd->count; k++){
+        ref_queue_fill(&vd->neighborhoods[k].queue, t);
+    }
+    ref_queue_clear(&vd->changed);
+}
+
+/**
+ * @brief Hands the changed nodes to every neighborhood but the one that changed them,
+ * which already queued them again
+ */
+static void vns_descent_spread(vns_descent* vd, int from){
+    while(vd->changed.size > 0){
+        int node = ref_queue_pop(&vd->changed);
+        for(int k=0; k<vd->count; k++){
+            if(k != from){
+                ref_queue_push(&vd->neighborhoods[k].queue, node);
+            }
+        }
+    }
+}
+
+/**
+ * @brief Next neighborhood with active nodes, -1 if none. In order, the first one, so that the
+ * descent goes back to the first neighborhood after any change; adaptive, a random one with
+ * probability proportional to its score
+ */
+static int vns_descent_pick(vns_descent* vd){
+    double best_score = 0;
+    int active = 0, first = -1;
+    for(int k=0; k<vd->count; k++){
+        if(vd->neighborhoods[k].queue.size > 0){
+            active++;
+            if(first == -1){
+                first = k;
+            }
+            best_score = fmax(best_score, vd->neighborhoods[k].score);
+        }
+    }
+    if(!vd->adaptive || active <= 1){
+        return first;
+    }
+
+    // until a neighborhood improves the tour all of them have the same weight
+    double floor = best_score > 0 ? VNS_SCORE_FLOOR * best_score : 1.0;
+    double total = 0;
+    for(int k=0; k<vd->count; k++){
+        if(vd->neighborhoods[k].queue.size > 0){
+            total += fmax(vd->neighborhoods[k].score, floor);
+        }
+    }
+
+    double r = rng_double(&vd->rng) * total;
+    int last = first;
+    for(int k=0; k<vd->count; k++){
+        if(vd->neighborhoods[k].queue.size > 0){
+            last = k;
+            r -= fmax(vd->neighborhoods[k].score, floor);
+            if(r <= 0){
+                return k;
+            }
+        }
+    }
+
+    return last;
+}
+
+ERROR_CODE vns_local_search(instance* inst, tour* t, double* cost, vns_descent* vd){
+    // the endpoints of the shaking are active for every neighborhood
+    vns_descent_spread(vd, -1);
+
+    ERROR_CODE e = OK;
+    int k;
+    while(e == OK && (k = vns_descent_pick(vd)) != -1){
+        vns_neighborhood* nb = &vd->neighborhoods[k];
+
+        double previous_cost = *cost;
+        double start = vns_cpu_ms();
+        e = nb->search(inst, t, cost, &nb->queue, &vd->changed);
+        double ms = vns_cpu_ms() - start;
+
+        // the score follows the recent improvements per CPU ms, a clock tick is the shortest time
+        double improvement = previous_cost - *cost;
+        nb->calls++;
+        nb->ms += ms;
+        if(improvement > -EPSILON){
+            nb->improving++;
+            nb->improvement += improvement;
+        }else{
+            improvement = 0;
+        }
+        double rate = improvement / fmax(ms, 1000.0 / CLOCKS_PER_SEC);
+        nb->score = (1 - VNS_SCORE_WEIGHT) * nb->score + VNS_SCORE_WEIGHT * rate;
+
+        vns_descent_spread(vd, k);
+    }
+
+    return e;
+}
+
+ERROR_CODE vns_shake(instance* inst, tour* t, double* cost, vns_descent* vd, int strength){
+    double start = vns_cpu_ms();
+
+    for(int j=0; j<strength; j++){
+        ERROR_CODE e = vns_kick(inst, t, cost, &vd->changed);
+        if(!err_ok(e)){
+            return e;
+        }
+    }
+
+    vd->kicks += strength;
+    vd->shakings++;
+    vd->kick_ms += vns_cpu_ms() - start;
+
+    return OK;
+}
+
+void vns_descent_report(const vns_descent* vd){
+    for(int k=0; k<vd->count; k++){
+        const vns_neighborhood* nb = &vd->neighborhoods[k];
+        log_info("VNS %-13s: %lld searches, %lld improving, improvement %f in %.1f CPU ms (%f per ms)",
+            vns_names[nb->type], nb->calls, nb->improving, nb->improvement, nb->ms, nb->ms > 0 ? nb->improvement / nb->ms : 0.0);
+    }
+    log_info("VNS shaking      : %lld shakings, %lld double-bridge kicks, %lld followed by a new best, %.1f CPU ms",
+        vd->shakings, vd->kicks, vd->successes, vd->kick_ms);
+}
+
 ERROR_CODE mh_VNS(instance* inst){
     tsp_solution solution = tsp_init_solution(inst->nnodes);
 
-    ERROR_CODE e = h_Greedy_iterative(inst); // start with a bad solution
-    if(!err_ok(e)){
+    // start from the tour given with -init or, without it, with a bad solution
+    ERROR_CODE e = tsp_warm_start(inst);
+    if(e != OK){
+        e = h_Greedy_iterative(inst);
+        if(!err_ok(e)){
             log_fatal("code %d : Error in greedy", e);
             tsp_handlefatal(inst);
             free(solution.path);
         }
-    log_info("Greedy done!");
+        log_info("Greedy done!");
+    }
     
-    // copy the best solution found by greedy
+    // copy the starting solution
     memcpy(solution.path, inst->best_solution.path, inst->nnodes * sizeof(int));
     solution.cost = inst->best_solution.cost;
 
     tsp_solution best_vns = tsp_init_solution(inst->nnodes);
+    memcpy(best_vns.path, solution.path, inst->nnodes * sizeof(int));
     best_vns.cost = solution.cost;
 
+    // the tour is kept across local search and kicks
+    tour t;
+    if(!err_ok(tour_init(&t, inst->nnodes))){
+        log_fatal("code %d : Error in tour allocation", RESOURCE_EXHAUSTED);
+        tsp_handlefatal(inst);
+    }
+    tour_from_successors(&t, solution.path);
+
+    // active nodes of the neighborhoods, allocated once: the first descent looks at every node,
+    // then only the endpoints of the kicks are queued
+    vns_descent vd;
+    if(!err_ok(vns_descent_init(inst, &vd))){
+        log_fatal("code %d : Error in descent allocation", RESOURCE_EXHAUSTED);
+        tsp_handlefatal(inst);
+    }
+    vns_descent_all(&vd, &t);
+
+    // shaking grows stronger while the search does not improve
+    int strength = LOWER;
+
     // file to hold solution value in each iteration
     FILE* f = fopen("results/VNSResults.dat", "w+");
     
@@ -254,16 +1079,13 @@ ERROR_CODE mh_VNS(instance* inst){
     // call 3 opt k times
     for(int i=0; i<inst->options_t.k; i++){
         // check if exceeds time
-        double ex_time = utils_timeelapsed(inst->c);
-        if(inst->options_t.timelimit != -1.0){
-            if(ex_time > inst->options_t.timelimit){
-               e = DEADLINE_EXCEEDED;
-               break;
-            }
+        if(deadline_expired(&inst->deadline)){
+            e = DEADLINE_EXCEEDED;
+            break;
         }
 
         // local search
-        e = ref_2opt(inst, &solution);
+        e = vns_local_search(inst, &t, &solution.cost, &vd);
         if(!err_ok(e)){
             log_fatal("code %d : Error in local search", e); 
             tsp_handlefatal(inst);
@@ -272,24 +1094,30 @@ ERROR_CODE mh_VNS(instance* inst){
         }
 
         if(solution.cost < best_vns.cost){
-            log_info("found new best: %d ", solution.cost);
+            log_info("found new best: %f ", solution.cost);
             best_vns.cost = solution.cost;
-            memcpy(best_vns.path, solution.path, inst->nnodes * sizeof(int));
+            tour_to_successors(&t, best_vns.path);
+            // every descent but the first one follows a shaking
+            vd.successes += i > 0;
+            strength = LOWER;
+        }else{
+            strength = strength == UPPER ? LOWER : strength + 1;
+        }
+
+        if(tsp_checkpoint_due(inst, best_vns.cost)){
+            tsp_checkpoint(inst, best_vns.path, best_vns.cost);
         }
 
         // save current iteration and current solution cost to file for the plot
         fprintf(f, "%d,%f\n", i, solution.cost);
 
         // kick
-        int r = rand() % (UPPER - LOWER + 1) - LOWER;
-        for(int j=0; j<r; j++){
-            e = vns_kick(inst, &solution);
-            if(!err_ok(e)){
-                log_fatal("code %d : Error in kick", e); 
-                tsp_handlefatal(inst);
-                free(solution.path);
-                free(best_vns.path);
-            }
+        e = vns_shake(inst, &t, &solution.cost, &vd, strength);
+        if(!err_ok(e)){
+            log_fatal("code %d : Error in kick", e); 
+            tsp_handlefatal(inst);
+            free(solution.path);
+            free(best_vns.path);
         }
         
     }
@@ -300,6 +1128,7 @@ ERROR_CODE mh_VNS(instance* inst){
     if(!err_ok(e)){
         log_error("code %d : error in updating best solution of VNS");
     }
+    tsp_checkpoint(inst, inst->best_solution.path, inst->best_solution.cost);
 
     // plot the solution progression during iterations
     PLOT plot = plot_open("VNSIterationsPlot");
@@ -311,70 +1140,80 @@ ERROR_CODE mh_VNS(instance* inst){
     plot_stats(plot, "results/VNSResults.dat");
     plot_free(plot);
 
+    vns_descent_report(&vd);
+
+    tour_free(&t);
+    vns_descent_free(&vd);
     free(best_vns.path);
     free(solution.path);
     return e;
 }
 
-// 3 opt kick
-ERROR_CODE vns_kick(instance* inst, tsp_solution* solution){
+// double-bridge kick
+ERROR_CODE vns_kick(instance* inst, tour* t, double* cost, ref_queue* changed){
 
     log_debug("KICK");
 
-    int *prev = calloc(inst->nnodes, sizeof(int));          // save the path of the solution without kick
-    for (int i = 0; i < inst->nnodes; i++) {
-        prev[solution->path[i]] = i;
+    // too small to have four edges to exchange
+    if(inst->nnodes < 8){
+        return OK;
     }
 
-    int indexes[3];
-    int i, j;
-    for (i = 0; i < 3; i++) {
+    int nodes[4];
+    for (int i = 0; i < 4; i++) {
         int random_number;
+        bool repeated;
         do {
-            random_number = rand() % (inst->nnodes + 1);
+            random_number = rng_int(&inst->rng, inst->nnodes);
             // Check if the number is already generated
-            for (j = 0; j < i; j++) {
-                if (random_number == indexes[j]) {
-                    random_number = -1; // Mark as invalid
+            repeated = false;
+            for (int j = 0; j < i; j++) {
+                if (random_number == nodes[j]) {
+                    repeated = true;
                     break;
                 }
             }
-        } while (random_number == -1); // Repeat if the number is already generated
-        indexes[i] = random_number;
-
-        // make them in order
-        for (int j = i; j > 0; j--) {
-                if (indexes[j] < indexes[j - 1])
-                    swap(&indexes[j], &indexes[j-1]);
-            }
+        } while (repeated); // Repeat if the number is already generated
+        nodes[i] = random_number;
     }
 
-    log_debug("random number: %d %d %d", indexes[0], indexes[1], indexes[2]);
-    //int case_swap = rand() % (8);
-    //log_debug("case swap: %d", case_swap);
+    return vns_kick_at(inst, t, cost, nodes, changed);
+}
 
-    // trasform in tour
-    int* tour = calloc(inst->nnodes, sizeof(int));
-    int node = solution->path[0];
-    for(int i=0; i<inst->nnodes; ++i) {
-        tour[i] = node;
-        node = solution->path[node];
+ERROR_CODE vns_kick_at(instance* inst, tour* t, double* cost, int nodes[4], ref_queue* changed){
+    // make them in tour order going forward from the first one
+    for(int q=2; q<4; q++){
+        for(int p=q; p>1 && !tour_between(t, nodes[0], nodes[p-1], nodes[p]); p--){
+            swap(&nodes[p-1], &nodes[p]);
+        }
     }
 
-    int nodeA = tour[indexes[0]];
-    int nodeB = tour[indexes[1]];
-    int nodeC = tour[indexes[2]];
-
-    ERROR_CODE e = makeMove(inst, prev, solution, 7, nodeA, solution->path[nodeA], nodeB, solution->path[nodeB], nodeC, solution->path[nodeC]);
-    if(!err_ok(e)){
-        log_fatal("code %d : Error in make move", e); 
-        tsp_handlefatal(inst);
-        free(prev);
+    log_debug("random nodes: %d %d %d %d", nodes[0], nodes[1], nodes[2], nodes[3]);
+
+    // the four cut edges split the tour in A = a1..a, B = b1..b2, C = c1..c2, D = d1..d2
+    int a = nodes[0], b1 = tour_next(t, a);
+    int b2 = nodes[1], c1 = tour_next(t, b2);
+    int c2 = nodes[2], d1 = tour_next(t, c2);
+    int d2 = nodes[3], a1 = tour_next(t, d2);
+
+    // A D C B: every edge changes and no single bridge is a tour, so 3opt cannot undo it
+    *cost += tsp_get_cost(inst, a, d1) + tsp_get_cost(inst, d2, c1) + tsp_get_cost(inst, c2, b1) + tsp_get_cost(inst, b2, a1)
+        - tsp_get_cost(inst, a, b1) - tsp_get_cost(inst, b2, c1) - tsp_get_cost(inst, c2, d1) - tsp_get_cost(inst, d2, a1);
+
+    // B C D reversed as a block, then every segment back in its direction
+    tour_swap_edges(t, a, b1, d2, a1);
+    tour_swap_edges(t, a, d2, d1, c2);
+    tour_swap_edges(t, d2, c2, c1, b2);
+    tour_swap_edges(t, c2, b2, b1, a1);
+
+    // only the endpoints of the four exchanged edges need a new local search
+    if(changed != NULL){
+        int touched[8] = {a, b1, b2, c1, c2, d1, d2, a1};
+        for(int q=0; q<8; q++){
+            ref_queue_push(changed, touched[q]);
+        }
     }
 
-    // free resources
-    free(prev);
-
     return OK;
 }
 
@@ -387,92 +1226,45 @@ bool is_in_tabu_list(tabu_search* ts, int node, int current_iteration){
     return current_iteration - ts->tabu_list[node] < ts->tenure && ts->tabu_list[node] != -1;
 }
 
-void tabu_free(tabu_search* ts){
-    free(ts->tabu_list);
+void tabu_history_free(tabu_history* h){
+    free(h->seen);
+    free(h->last_visit);
+    free(h->visits);
+    h->seen = NULL;
+    h->last_visit = NULL;
+    h->visits = NULL;
 }
 
-// https://tsp-basics.blogspot.com/2017/03/3-opt-move.html
-// TODO: cases 4-5-6
-ERROR_CODE makeMove(instance *inst, int *prev, tsp_solution* solution, int bestCase, int i, int succ_i, int j, int succ_j, int k, int succ_k) {
-    ERROR_CODE e = OK;
-    int temp;
-    switch (bestCase){
-        case 1: 
-            log_debug("case 1");
-
-            // invert segment a
-            ref_reverse_path(inst, k, succ_k, i, succ_i, prev, solution->path);
-
-            break;
-        case 2:
-            log_debug("case 2");
-            
-            // invert segment c
-            ref_reverse_path(inst, j, succ_j, k, succ_k, prev, solution->path);
-
-            break;
-        case 3:
-            log_debug("case 3");
-            
-            // invert segment b
-            ref_reverse_path(inst, i, succ_i, j, succ_j, prev, solution->path);
-
-            break;
-        case 4:
-            // inverts segments b and c
-            log_debug("case 4");
-            ref_reverse_path(inst, i, succ_i, j, succ_j, prev, solution->path);
-            temp = j;
-            j = succ_i;
-            succ_i = j;
-            ref_reverse_path(inst, j, succ_j, k, succ_k, prev, solution->path);
-
-            /*solution->path[i] = j;
-            solution->path[succ_i] = k;
-            solution->path[succ_j] = succ_k;*/
-            break;
-        case 5:
-            // inverts segments a and b
-            log_debug("invert segment a and b");
-            ref_reverse_path(inst, k, succ_k, i, succ_i, prev, solution->path);
-            temp = i;
-            i = succ_k;
-            succ_k = temp;
-            ref_reverse_path(inst, i, succ_i, j, succ_j, prev, solution->path);
-
-            /*solution->path[i] = k;
-            solution->path[succ_j] = succ_i;
-            solution->path[j] = succ_k;*/
-            break;
-        case 6:
-            // inverts segments a and c
-            log_debug("invert segment a and c");
-            ref_reverse_path(inst, j, succ_j, k, succ_k, prev, solution->path);
-            temp = k;
-            k = succ_j;
-            succ_j = temp;
-            ref_reverse_path(inst, k, succ_k, i, succ_i, prev, solution->path);
-
-            /*solution->path[i] = succ_j;
-            solution->path[k] = j;
-            solution->path[succ_i] = succ_k;*/
-
-            break;
-        case 7:
-            log_debug("case 7");
-
-            // swap edges
-            solution->path[i] = succ_j; 
-            solution->path[k] = succ_i; 
-            solution->path[j] = succ_k; 
-
-            // doesn't need reverse!
+void tabu_cache_free(tabu_cache* tc){
+    free(tc->heap);
+    free(tc->pos);
+    free(tc->delta);
+    free(tc->other);
+    free(tc->forward);
+    free(tc->stamp);
+    free(tc->expiring);
+    free(tc->expiring_since);
+    tc->heap = NULL;
+    tc->pos = NULL;
+    tc->delta = NULL;
+    tc->other = NULL;
+    tc->forward = NULL;
+    tc->stamp = NULL;
+    tc->expiring = NULL;
+    tc->expiring_since = NULL;
+}
 
-            break;
-        
-        default:
-            break;
+void vns_descent_free(vns_descent* vd){
+    for(int k=0; k<vd->count; k++){
+        ref_queue_free(&vd->neighborhoods[k].queue);
     }
+    ref_queue_free(&vd->changed);
+    vd->count = 0;
+}
 
-    return e;
+void tabu_free(tabu_search* ts){
+    free(ts->tabu_list);
+    free(ts->forbidden);
+    ts->tabu_list = NULL;
+    ts->forbidden = NULL;
 }
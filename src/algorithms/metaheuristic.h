@@ -3,23 +3,22 @@
 
 #include "heuristics.h"
 
-#define UPPER 10
-#define LOWER 2
+#define UPPER 10                    // double-bridge kicks of the strongest shaking of VNS
+#define LOWER 2                     // double-bridge kicks of the weakest shaking of VNS
+
+#define VNS_SCORE_WEIGHT 0.2        // weight of the last search in the average improvement per CPU ms of a neighborhood
+#define VNS_SCORE_FLOOR 0.05        // share of the best score given to every neighborhood, so that none starves
 
 // https://www.sciencedirect.com/science/article/abs/pii/S0305054897000300?via%3Dihub
 #define MAX_FRACTION 0.25
 #define MIN_FRACTION 0.125
 
-/**
- * @brief Policies for Tabu Search
- * 
- */
-typedef enum{
-    POL_FIXED = 0,
-    POL_SIZE = 1,
-    POL_RANDOM = 2,
-    POL_LINEAR = 3
-} POLICIES;
+// reactive tabu search, Battiti and Tecchiolli, https://doi.org/10.1287/ijoc.6.2.126
+#define TABU_INCREASE 1.1           // tenure growth when a tour is visited again
+#define TABU_DECREASE 0.9           // tenure decay after a cycle length without repetitions
+#define TABU_REPETITIONS 3          // visits that make a tour a sign of chaotic trapping
+#define TABU_CHAOTIC 3              // chaotic tours that trigger an escape
+#define TABU_HISTORY_SLOTS 1024     // initial slots of the table of visited tours
 
 /**
  * @brief Tabu search utils
@@ -35,8 +34,87 @@ typedef struct {
     bool increment;             // flag for the linear policy
 
     int* tabu_list;             // tabu list, nnodes long, each element is the last iteration the element has been encountered
+    char* forbidden;            // nodes in the tabu list at the current iteration, nnodes long
+
+    rng_state rng;              // random stream of the walker
+    int last_move[4];           // endpoints of the last 2opt move, (a, a2) and (c, c2) became (a, c) and (a2, c2); -1 if none
 } tabu_search;
 
+/**
+ * @brief Visited tours for the reactive policy. A tour is hashed Zobrist-style as the xor of a
+ * 64 bit key per edge, so a 2opt move updates it in O(1); hashes are kept in an open-addressing table
+ * 
+ */
+typedef struct {
+    uint64_t hash;              // hash of the current tour
+    uint64_t* seen;             // hashes of the visited tours, 0 for an empty slot
+    int* last_visit;            // iteration of the last visit of the tour in each slot
+    int* visits;                // visits of the tour in each slot
+    int capacity;               // slots, a power of 2
+    int size;                   // occupied slots
+
+    double cycle_length;        // moving average of the iterations between two visits of a tour
+    int last_change;            // iteration of the last tenure change
+    int chaotic;                // tours visited more than TABU_REPETITIONS times since the last escape
+} tabu_history;
+
+/**
+ * @brief Best candidate 2opt move of every node, kept in an indexed min-heap on the delta.
+ * A move only changes the tour edges of its four endpoints, so only they and the nodes
+ * leaving the tabu list are recomputed eagerly; any other entry is recomputed when it
+ * reaches the top of the heap and applied only if it is still the best
+ * 
+ */
+typedef struct {
+    int nnodes;
+    int* heap;                  // nodes ordered by (delta, node)
+    int* pos;                   // position of each node in the heap
+    double* delta;              // best delta of each node, __DBL_MAX__ if it has no allowed move
+    int* other;                 // candidate joined to the node by its best move
+    char* forward;              // 1 if the best move removes the edges to the successors, 0 to the predecessors
+    int* stamp;                 // iteration for which the entry of each node was computed
+
+    int* expiring;              // nodes made tabu, in order of iteration
+    int* expiring_since;        // iteration at which they were made tabu
+    int expiring_head;
+    int expiring_size;
+    int expiring_capacity;
+} tabu_cache;
+
+/**
+ * @brief Neighborhood of the descent of VNS, with its active nodes and statistics
+ * 
+ */
+typedef struct {
+    local_search type;
+    ref_local_search search;
+    ref_queue queue;            // nodes to look at, the ones changed by any neighborhood since the last search
+
+    long long calls;            // searches, i.e. times the neighborhood was picked
+    long long improving;        // searches that lowered the cost
+    double improvement;         // total cost decrease
+    double ms;                  // total CPU milliseconds
+    double score;               // moving average of the improvement per CPU millisecond
+} vns_neighborhood;
+
+/**
+ * @brief Variable neighborhood descent: the neighborhoods are run, in order or picked by score, until
+ * none of them has active nodes. The nodes changed by a neighborhood are handed to all the others
+ * 
+ */
+typedef struct {
+    vns_neighborhood neighborhoods[VNS_MAX_NEIGHBORHOODS];
+    int count;
+    bool adaptive;              // pick neighborhoods by score instead of in order
+    rng_state rng;              // stream of the adaptive picks
+    ref_queue changed;          // nodes changed by the last search or shaking
+
+    long long kicks;            // double-bridge kicks of the shakings
+    long long shakings;
+    long long successes;        // shakings followed by a new best tour
+    double kick_ms;             // total CPU milliseconds of the shakings
+} vns_descent;
+
 //================================================================================
 // TABU SEARCH
 //================================================================================
@@ -47,18 +125,189 @@ ERROR_CODE tabu_dependent_policy(tabu_search* t);
 ERROR_CODE tabu_random_policy(tabu_search* t);
 ERROR_CODE tabu_linear_policy(tabu_search* ts);
 
+/**
+ * @brief Reactive policy: called after each move, it records the current tour and raises the tenure
+ * when the tour was already visited, lowers it when no tour repeats for a cycle length
+ * 
+ * @param ts tabu search state
+ * @param h history, with the hash of the current tour
+ * @param current_iteration 
+ * @return true if the search is trapped and needs an escape
+ */
+bool tabu_reactive_policy(tabu_search* ts, tabu_history* h, int current_iteration);
+
+/**
+ * @brief Tabu search from the tour of options_t.initfile or the greedy + 2opt tour, with options_t.tabu_walkers
+ * walkers on their own threads. Walker w uses the w-th policy after the given one and its own random stream; they
+ * share the best tour and, every options_t.tabu_restart iterations, a walker behind it restarts from it.
+ * The best tour is checkpointed to options_t.checkpointfile
+ * 
+ * @param inst 
+ * @param policy policy of the first walker
+ * @return ERROR_CODE 
+ */
 ERROR_CODE mh_TabuSearch(instance* inst, POLICIES policy);
 
 ERROR_CODE tabu_init(tabu_search* ts, int nnodes, POLICIES policy);
-ERROR_CODE tabu_best_move(instance* inst, int* solution_path, double* solution_cost, tabu_search* ts, int current_iteration);
+ERROR_CODE tabu_best_move(instance* inst, tour* t, double* solution_cost, tabu_search* ts, int current_iteration);
+
+/**
+ * @brief Allocates the table of visited tours and hashes the tour
+ * 
+ * @param h 
+ * @param t current tour
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tabu_history_init(tabu_history* h, tour* t);
+
+/**
+ * @brief Recomputes the hash of the tour from scratch, in O(n)
+ * 
+ * @param h 
+ * @param t current tour
+ */
+void tabu_history_rehash(tabu_history* h, tour* t);
+
+/**
+ * @brief Updates the hash of the tour after the 2opt move of tabu_search.last_move, in O(1)
+ * 
+ * @param h 
+ * @param ts 
+ */
+void tabu_history_move(tabu_history* h, tabu_search* ts);
+
+/**
+ * @brief Escape of the reactive policy: random double bridges, proportional to the cycle length,
+ * followed by an empty tabu list
+ * 
+ * @param inst tsp instance
+ * @param t current tour
+ * @param solution_cost cost of the tour, updated with the kicks
+ * @param ts tabu search state
+ * @param h history, rehashed after the kicks
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tabu_escape(instance* inst, tour* t, double* solution_cost, tabu_search* ts, tabu_history* h);
+
+/**
+ * @brief Allocates the move cache of tabu search
+ * 
+ * @param tc 
+ * @param nnodes 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tabu_cache_init(tabu_cache* tc, int nnodes);
+
+/**
+ * @brief Recomputes the best candidate move of every node, in O(n k)
+ * 
+ * @param inst tsp instance, with candidate lists
+ * @param t current tour
+ * @param ts tabu search state
+ * @param tc cache
+ * @param current_iteration 
+ */
+void tabu_cache_build(instance* inst, tour* t, tabu_search* ts, tabu_cache* tc, int current_iteration);
+
+/**
+ * @brief Applies the best non tabu candidate 2opt move, even if it worsens the tour, in
+ * O(k log n) per recomputed entry instead of the O(n^2) of tabu_best_move
+ * 
+ * @param inst tsp instance, with candidate lists
+ * @param t current tour
+ * @param solution_cost cost of the tour, updated with the move
+ * @param ts tabu search state
+ * @param tc cache built by tabu_cache_build
+ * @param current_iteration 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tabu_cached_move(instance* inst, tour* t, double* solution_cost, tabu_search* ts, tabu_cache* tc, int current_iteration);
 
 //================================================================================
 // VARIABLE NEIGHBORHOOD SEARCH
 //================================================================================
 
+/**
+ * @brief Variable neighborhood search from the tour of options_t.initfile or the best greedy tour.
+ * The best tour is checkpointed to options_t.checkpointfile
+ * 
+ * @param inst 
+ * @return ERROR_CODE 
+ */
 ERROR_CODE mh_VNS(instance* inst);
 
-ERROR_CODE vns_kick(instance* inst, tsp_solution* solution);
+/**
+ * @brief Kick of VNS on four random nodes
+ * 
+ * @param inst tsp instance
+ * @param t tour
+ * @param cost cost of the tour, updated with the kick
+ * @param changed if not NULL, receives the endpoints of the exchanged edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE vns_kick(instance* inst, tour* t, double* cost, ref_queue* changed);
+
+/**
+ * @brief Kick of VNS on given nodes: double bridge on the edges leaving them, the segments
+ * A B C D between them are reconnected as A D C B without reversing any
+ * 
+ * @param inst tsp instance
+ * @param t tour
+ * @param cost cost of the tour, updated with the kick
+ * @param nodes four distinct nodes, sorted in tour order
+ * @param changed if not NULL, receives the endpoints of the exchanged edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE vns_kick_at(instance* inst, tour* t, double* cost, int nodes[4], ref_queue* changed);
+
+/**
+ * @brief Sets the neighborhoods of the descent from options_t.vns_neighborhoods or, if not set,
+ * from options_t.vns_ls followed by Or-opt if options_t.oropt is set
+ * 
+ * @param inst tsp instance
+ * @param vd 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE vns_descent_init(instance* inst, vns_descent* vd);
+
+/**
+ * @brief Makes every node active in every neighborhood
+ * 
+ * @param vd 
+ * @param t current tour
+ */
+void vns_descent_all(vns_descent* vd, tour* t);
+
+/**
+ * @brief Local search of VNS: descent from the active nodes, i.e. the ones in vd->changed
+ * and the ones left by previous searches
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @param vd 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE vns_local_search(instance* inst, tour* t, double* cost, vns_descent* vd);
+
+/**
+ * @brief Shaking of VNS: strength double-bridge kicks, whose endpoints become active
+ * 
+ * @param inst tsp instance
+ * @param t tour
+ * @param cost cost of the tour, updated with the kicks
+ * @param vd 
+ * @param strength number of kicks
+ * @return ERROR_CODE 
+ */
+ERROR_CODE vns_shake(instance* inst, tour* t, double* cost, vns_descent* vd, int strength);
+
+/**
+ * @brief Logs calls, successes and time of every neighborhood and of the shakings
+ * 
+ * @param vd 
+ */
+void vns_descent_report(const vns_descent* vd);
 
 
 //================================================================================
@@ -83,6 +332,25 @@ bool is_in_tabu_list(tabu_search* ts, int b, int current_iteration);
  */
 void tabu_free(tabu_search* ts);
 
-ERROR_CODE makeMove(instance *inst, int *prev, tsp_solution* solution, int bestCase, int i, int succ_i, int j, int succ_j, int k, int succ_k);
+/**
+ * @brief Util to free the table of visited tours
+ * 
+ * @param h 
+ */
+void tabu_history_free(tabu_history* h);
+
+/**
+ * @brief Util to free the move cache of tabu search
+ * 
+ * @param tc 
+ */
+void tabu_cache_free(tabu_cache* tc);
+
+/**
+ * @brief Util to free the queues of the descent of VNS
+ * 
+ * @param vd 
+ */
+void vns_descent_free(vns_descent* vd);
 
 #endif
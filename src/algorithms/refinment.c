@@ -1,5 +1,32 @@
 #include "refinment.h"
 
+/**
+ * @brief Runs a queue-based local search from every node, in tour order for locality
+ */
+static ERROR_CODE ref_search_all(instance* inst, tour* t, double* cost, ref_local_search search){
+    ref_queue queue;
+    if(!err_ok(ref_queue_init(&queue, inst->nnodes))){
+        return RESOURCE_EXHAUSTED;
+    }
+    ref_queue_fill(&queue, t);
+
+    ERROR_CODE e = search(inst, t, cost, &queue, NULL);
+
+    ref_queue_free(&queue);
+
+    return e;
+}
+
+/**
+ * @brief Queues an endpoint of a changed edge again, and reports it in changed if not NULL
+ */
+static inline void ref_wake(ref_queue* queue, ref_queue* changed, int node){
+    ref_queue_push(queue, node);
+    if(changed != NULL){
+        ref_queue_push(changed, node);
+    }
+}
+
 ERROR_CODE ref_2opt(instance* inst, tsp_solution* solution){
 
     // re-initialize cost for VNS
@@ -8,104 +35,1132 @@ ERROR_CODE ref_2opt(instance* inst, tsp_solution* solution){
         solution->cost += tsp_get_cost(inst, i, solution->path[i]);
     }
 
+    tour t;
+    if(!err_ok(tour_init(&t, inst->nnodes))){
+        log_error("code %d : Error in tour allocation", RESOURCE_EXHAUSTED);
+        return RESOURCE_EXHAUSTED;
+    }
+    tour_from_successors(&t, solution->path);
+
+    ERROR_CODE e = ref_2opt_tour(inst, &t, &solution->cost);
+
+    tour_to_successors(&t, solution->path);
+    tour_free(&t);
+    
+    ERROR_CODE error = tsp_update_best_solution(inst, solution);
+    if(!err_ok(error)){
+        log_error("code %d : Error in 2opt solution update", error);
+    }
+    
+    return e;
+}
+
+ERROR_CODE ref_2opt_tour(instance* inst, tour* t, double* cost){
+    if(inst->options_t.twoopt == TWOOPT_FIRST){
+        return ref_2opt_first(inst, t, cost);
+    }
+
     ERROR_CODE e = OK;
     
     double delta = 0;
 
     do {
         // see if it exceeds the time limit
-        if(inst->options_t.timelimit != -1.0){
-            double ex_time = utils_timeelapsed(inst->c);
-            if(ex_time > inst->options_t.timelimit){
-                log_debug("time limit exceeded");
-                e = DEADLINE_EXCEEDED;
-            }
+        if(deadline_expired(&inst->deadline)){
+            log_debug("time limit exceeded");
+            e = DEADLINE_EXCEEDED;
+            break;
         }
 
-        delta = ref_2opt_once(inst, solution);
+        delta = ref_2opt_once(inst, t, cost);
     }while(delta < EPSILON);
-    
+
+    return e;
+}
+
+ERROR_CODE ref_2opt_first(instance* inst, tour* t, double* cost){
+    return ref_search_all(inst, t, cost, ref_2opt_queue);
+}
+
+ERROR_CODE ref_2opt_best_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed){
+    ERROR_CODE e = OK;
+    if(queue->size == 0){
+        return e;
+    }
+    ref_queue_clear(queue);
+
+    while(true){
+        // see if it exceeds the time limit
+        if(deadline_expired(&inst->deadline)){
+            log_debug("time limit exceeded");
+            e = DEADLINE_EXCEEDED;
+            break;
+        }
+
+        const int* succ = tour_successors(t);
+        ref_2opt_move best = ref_2opt_scan(inst, succ, NULL, 0);
+        if(best.a == -1 || best.delta >= EPSILON){
+            break;
+        }
+
+        int succ_a = succ[best.a];
+        int succ_b = succ[best.b];
+        tour_2opt_move(t, best.a, best.b);
+        *cost += best.delta;
+
+        if(changed != NULL){
+            ref_queue_push(changed, best.a);
+            ref_queue_push(changed, succ_a);
+            ref_queue_push(changed, best.b);
+            ref_queue_push(changed, succ_b);
+        }
+    }
+
+    return e;
+}
+
+ERROR_CODE ref_2opt_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed){
+    ERROR_CODE e = OK;
+    int n = inst->nnodes;
+    if(n < 4){
+        ref_queue_clear(queue);
+        return e;
+    }
+
+    const candidate_list* cl = &inst->candidates;
+    bool use_candidates = cl->type != CAND_NONE;
+    bool sorted = use_candidates && cl->type != CAND_ALPHA;     // lists by distance allow to stop at the first non-improving neighbor
+
+    int countdown = DEADLINE_PERIOD;
+    while(queue->size > 0){
+        // see if it exceeds the time limit
+        if(deadline_poll(&inst->deadline, &countdown, DEADLINE_PERIOD)){
+            log_debug("time limit exceeded");
+            e = DEADLINE_EXCEEDED;
+            break;
+        }
+
+        int a = ref_queue_pop(queue);
+
+        const int* neighbors = use_candidates ? cand_neighbors(cl, a) : NULL;
+        int count = use_candidates ? cand_count(cl, a) : n;
+
+        // best move around a, removing (a, a_next) and (c, c_next) in the same direction
+        double best_delta = EPSILON;
+        int best_dir = -1, best_c = -1;
+        for(int dir=0; dir<2; dir++){
+            int a_next = dir == 0 ? tour_next(t, a) : tour_prev(t, a);
+            double d_a = tsp_get_cost(inst, a, a_next);
+
+            for(int k=0; k<count; k++){
+                int c = use_candidates ? neighbors[k] : k;
+                if(c == a){
+                    continue;
+                }
+
+                // the new edge (a, c) must be shorter than the removed one
+                double g = tsp_get_cost(inst, a, c);
+                if(g >= d_a){
+                    if(sorted){
+                        break;
+                    }
+                    continue;
+                }
+
+                int c_next = dir == 0 ? tour_next(t, c) : tour_prev(t, c);
+                if(c == a_next || c_next == a){
+                    continue;
+                }
+
+                double delta = g + tsp_get_cost(inst, a_next, c_next) - d_a - tsp_get_cost(inst, c, c_next);
+                if(delta < best_delta){
+                    best_delta = delta;
+                    best_dir = dir;
+                    best_c = c;
+                }
+            }
+        }
+
+        if(best_dir == -1){
+            continue;
+        }
+
+        int c = best_c;
+        int a_next = best_dir == 0 ? tour_next(t, a) : tour_prev(t, a);
+        int c_next = best_dir == 0 ? tour_next(t, c) : tour_prev(t, c);
+        if(best_dir == 0){
+            tour_2opt_move(t, a, c);
+        }else{
+            tour_2opt_move(t, a_next, c_next);
+        }
+        *cost += best_delta;
+        log_trace("2-opt improved solution: new cost: %f", *cost);
+
+        // wake up the endpoints of the exchanged edges
+        int touched[4] = {a, a_next, c, c_next};
+        for(int q=0; q<4; q++){
+            ref_wake(queue, changed, touched[q]);
+        }
+    }
+
+    return e;
+}
+
+ERROR_CODE ref_oropt(instance* inst, tsp_solution* solution){
+
+    // re-initialize cost
+    solution->cost = 0;
+    for(int i=0; i<inst->nnodes; i++){
+        solution->cost += tsp_get_cost(inst, i, solution->path[i]);
+    }
+
+    tour t;
+    if(!err_ok(tour_init(&t, inst->nnodes))){
+        log_error("code %d : Error in tour allocation", RESOURCE_EXHAUSTED);
+        return RESOURCE_EXHAUSTED;
+    }
+    tour_from_successors(&t, solution->path);
+
+    ERROR_CODE e = ref_oropt_tour(inst, &t, &solution->cost);
+
+    tour_to_successors(&t, solution->path);
+    tour_free(&t);
+
     ERROR_CODE error = tsp_update_best_solution(inst, solution);
     if(!err_ok(error)){
-        log_error("code %d : Error in 2opt solution update", error);
+        log_error("code %d : Error in Or-opt solution update", error);
     }
-    
+
     return e;
 }
 
-double ref_2opt_once(instance* inst, tsp_solution* solution){
-    double best_delta = 0;
-    int best_swap[2] = {-1, -1};
+ERROR_CODE ref_oropt_tour(instance* inst, tour* t, double* cost){
+    return ref_search_all(inst, t, cost, ref_oropt_queue);
+}
 
-    int *prev = calloc(inst->nnodes, sizeof(int));          // save the path of the solution without 2opt
-    for (int i = 0; i < inst->nnodes; i++) {
-        prev[solution->path[i]] = i;
+ERROR_CODE ref_oropt_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed){
+    ERROR_CODE e = OK;
+    int n = inst->nnodes;
+    if(n < 2 * OROPT_MAX_SEGMENT + 2){
+        ref_queue_clear(queue);
+        return e;
     }
 
-    // scan nodes to find best swap
-    for (int a = 0; a < inst->nnodes - 1; a++) {
+    const candidate_list* cl = &inst->candidates;
+    bool use_candidates = cl->type != CAND_NONE;
+    bool sorted = use_candidates && cl->type != CAND_ALPHA;
+
+    int countdown = DEADLINE_PERIOD;
+    while(queue->size > 0){
+        // see if it exceeds the time limit
+        if(deadline_poll(&inst->deadline, &countdown, DEADLINE_PERIOD)){
+            log_debug("time limit exceeded");
+            e = DEADLINE_EXCEEDED;
+            break;
+        }
+
+        int a = ref_queue_pop(queue);
+
+        // best move of a segment that starts or ends in a
+        double best_delta = EPSILON;
+        int best[7] = {-1};            // p, s1, s2, nx, x, y, reversed
+
+        for(int len=1; len<=OROPT_MAX_SEGMENT; len++){
+            for(int dir=0; dir<(len == 1 ? 1 : 2); dir++){
+                // segment s1..s2 going forward, with a at one end
+                int segment[OROPT_MAX_SEGMENT];
+                segment[0] = a;
+                for(int l=1; l<len; l++){
+                    segment[l] = dir == 0 ? tour_next(t, segment[l - 1]) : tour_prev(t, segment[l - 1]);
+                }
+                int s1 = dir == 0 ? a : segment[len - 1];
+                int s2 = dir == 0 ? segment[len - 1] : a;
+                int p = tour_prev(t, s1);
+                int nx = tour_next(t, s2);
+
+                // gain of closing the gap left by the segment
+                double removed = tsp_get_cost(inst, p, s1) + tsp_get_cost(inst, s2, nx) - tsp_get_cost(inst, p, nx);
+                if(removed <= 0){
+                    continue;
+                }
+
+                // the segment goes next to a neighbor c of one of its ends
+                for(int end=0; end<(len == 1 ? 1 : 2); end++){
+                    int en = end == 0 ? s1 : s2;
+                    int other = end == 0 ? s2 : s1;
+
+                    const int* neighbors = use_candidates ? cand_neighbors(cl, en) : NULL;
+                    int count = use_candidates ? cand_count(cl, en) : n;
+
+                    for(int k=0; k<count; k++){
+                        int c = use_candidates ? neighbors[k] : k;
+
+                        // the new edge (en, c) must be shorter than the gain
+                        double g = tsp_get_cost(inst, en, c);
+                        if(g >= removed){
+                            if(sorted){
+                                break;
+                            }
+                            continue;
+                        }
+
+                        bool inside = false;
+                        for(int l=0; l<len; l++){
+                            inside |= segment[l] == c;
+                        }
+                        if(inside){
+                            continue;
+                        }
+
+                        // insert in (c, next(c)) as c-en..other-next(c), or in (prev(c), c) as prev(c)-other..en-c
+                        for(int side=0; side<2; side++){
+                            int x = side == 0 ? c : tour_prev(t, c);
+                            int y = side == 0 ? tour_next(t, c) : c;
+                            if(x == s2 || y == s1){
+                                continue;
+                            }
+
+                            double added = side == 0 ? g + tsp_get_cost(inst, other, y) : tsp_get_cost(inst, x, other) + g;
+                            double delta = added - tsp_get_cost(inst, x, y) - removed;
+                            if(delta < best_delta){
+                                best_delta = delta;
+                                best[0] = p; best[1] = s1; best[2] = s2; best[3] = nx;
+                                best[4] = x; best[5] = y;
+                                // x-s1..s2-y keeps the direction of the segment
+                                best[6] = (side == 0) != (en == s1);
+                            }
+                        }
+                    }
+                }
+            }
+        }
+
+        if(best[0] == -1){
+            continue;
+        }
+
+        ref_oropt_move(t, best[0], best[1], best[2], best[3], best[4], best[5], best[6]);
+        *cost += best_delta;
+        log_trace("Or-opt improved solution: new cost: %f", *cost);
+
+        // wake up the endpoints of the changed edges
+        for(int q=0; q<6; q++){
+            ref_wake(queue, changed, best[q]);
+        }
+    }
+
+    return e;
+}
+
+ERROR_CODE ref_3opt(instance* inst, tsp_solution* solution){
+
+    // re-initialize cost
+    solution->cost = 0;
+    for(int i=0; i<inst->nnodes; i++){
+        solution->cost += tsp_get_cost(inst, i, solution->path[i]);
+    }
+
+    tour t;
+    if(!err_ok(tour_init(&t, inst->nnodes))){
+        log_error("code %d : Error in tour allocation", RESOURCE_EXHAUSTED);
+        return RESOURCE_EXHAUSTED;
+    }
+    tour_from_successors(&t, solution->path);
+
+    ERROR_CODE e = ref_3opt_tour(inst, &t, &solution->cost);
+
+    tour_to_successors(&t, solution->path);
+    tour_free(&t);
+
+    ERROR_CODE error = tsp_update_best_solution(inst, solution);
+    if(!err_ok(error)){
+        log_error("code %d : Error in 3opt solution update", error);
+    }
+
+    return e;
+}
+
+/**
+ * @brief Walk of the tour in one of its two directions
+ */
+static inline int ref_step(const tour* t, int dir, int a){
+    return dir == 0 ? tour_next(t, a) : tour_prev(t, a);
+}
+
+/**
+ * @brief Whether b lies on the path from a to c, walking in direction dir
+ */
+static inline bool ref_between(const tour* t, int dir, int a, int b, int c){
+    return dir == 0 ? tour_between(t, a, b, c) : tour_between(t, c, b, a);
+}
+
+/**
+ * @brief Best 3opt move found so far
+ */
+typedef struct {
+    double delta;
+    int reconnection;
+    int nodes[6];               // i, succ_i, j, succ_j, k, succ_k
+} ref_3opt_move;
+
+/**
+ * @brief Evaluates every reconnection of the edges (i, succ_i), (j, succ_j), (k, succ_k)
+ * if they are distinct and met in this order walking in direction dir
+ */
+static void ref_3opt_try(instance* inst, const tour* t, int dir, int i, int j, int k, ref_3opt_move* best){
+    if(i == j || j == k || k == i || !ref_between(t, dir, i, j, k)){
+        return;
+    }
+
+    int succ_i = ref_step(t, dir, i);
+    int succ_j = ref_step(t, dir, j);
+    int succ_k = ref_step(t, dir, k);
+
+    for(int r=1; r<=7; r++){
+        double delta = ref_3opt_delta(inst, r, i, succ_i, j, succ_j, k, succ_k);
+        if(delta < best->delta){
+            best->delta = delta;
+            best->reconnection = r;
+            int nodes[6] = {i, succ_i, j, succ_j, k, succ_k};
+            memcpy(best->nodes, nodes, sizeof(nodes));
+        }
+    }
+}
+
+ERROR_CODE ref_3opt_tour(instance* inst, tour* t, double* cost){
+    return ref_search_all(inst, t, cost, ref_3opt_queue);
+}
+
+ERROR_CODE ref_3opt_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed){
+    ERROR_CODE e = OK;
+    int n = inst->nnodes;
+    if(n < 8){
+        return ref_2opt_queue(inst, t, cost, queue, changed);
+    }
+
+    const candidate_list* cl = &inst->candidates;
+    bool use_candidates = cl->type != CAND_NONE;
+    bool sorted = use_candidates && cl->type != CAND_ALPHA;
+
+    int countdown = DEADLINE_PERIOD;
+    while(queue->size > 0){
+        // see if it exceeds the time limit
+        if(deadline_poll(&inst->deadline, &countdown, DEADLINE_PERIOD)){
+            log_debug("time limit exceeded");
+            e = DEADLINE_EXCEEDED;
+            break;
+        }
+
+        int a = ref_queue_pop(queue);
+
+        ref_3opt_move best = { .delta = EPSILON, .reconnection = 0 };
+
+        // a is i and (i, succ_i) is the first removed edge, in both directions of the tour
+        for(int dir=0; dir<2; dir++){
+            int i = a;
+            int succ_i = ref_step(t, dir, i);
+            double removed = tsp_get_cost(inst, i, succ_i);
+
+            const int* neighbors = use_candidates ? cand_neighbors(cl, i) : NULL;
+            int count = use_candidates ? cand_count(cl, i) : n;
+
+            // the edge added at i is (i, c): c is j, succ_j or k depending on the reconnection
+            for(int q=0; q<count; q++){
+                int c = use_candidates ? neighbors[q] : q;
+                if(c == i || c == succ_i){
+                    continue;
+                }
+
+                double g1 = removed - tsp_get_cost(inst, i, c);
+                if(g1 <= 0){
+                    if(sorted){
+                        break;
+                    }
+                    continue;
+                }
+
+                // c = k: cases 1 and 5, j is reached from succ_i through (succ_i, succ_j)
+                // c = j or c = succ_j: cases 3, 4, 6 and 7, k is reached from succ_i or j
+                int c_prev = ref_step(t, 1 - dir, c);
+                int c_next = ref_step(t, dir, c);
+                int from[2] = {succ_i, c_prev};
+
+                // second removed edge, on either side of c
+                double removed_c = fmax(tsp_get_cost(inst, c_prev, c), tsp_get_cost(inst, c, c_next));
+                for(int f=0; f<2; f++){
+                    const int* second = use_candidates ? cand_neighbors(cl, from[f]) : NULL;
+                    int second_count = use_candidates ? cand_count(cl, from[f]) : n;
+
+                    for(int r=0; r<second_count; r++){
+                        int d = use_candidates ? second[r] : r;
+                        if(d == from[f]){
+                            continue;
+                        }
+
+                        // partial gain with the second added edge, cut only on the nearest ones
+                        double g2 = g1 + removed_c - tsp_get_cost(inst, from[f], d);
+                        if(g2 <= 0){
+                            if(sorted){
+                                break;
+                            }
+                            continue;
+                        }
+
+                        int d_prev = ref_step(t, 1 - dir, d);
+                        if(f == 0){
+                            ref_3opt_try(inst, t, dir, i, c, d, &best);          // 4: (succ_i, k)
+                            ref_3opt_try(inst, t, dir, i, c_prev, d, &best);     // 7: (k, succ_i)
+                            ref_3opt_try(inst, t, dir, i, c_prev, d_prev, &best); // 6: (succ_i, succ_k)
+                            ref_3opt_try(inst, t, dir, i, d_prev, c, &best);     // 5: (succ_i, succ_j)
+                        }else{
+                            ref_3opt_try(inst, t, dir, i, c_prev, d, &best);     // 6: (j, k)
+                            ref_3opt_try(inst, t, dir, i, c_prev, d_prev, &best);
+                        }
+                    }
+                }
+
+                // the 2opt reconnections only need c
+                ref_3opt_try(inst, t, dir, i, c, c_next, &best);
+                ref_3opt_try(inst, t, dir, i, c_prev, c, &best);
+            }
+        }
+
+        if(best.reconnection == 0){
+            continue;
+        }
+
+        int* nodes = best.nodes;
+        makeMove(inst, t, best.reconnection, nodes[0], nodes[1], nodes[2], nodes[3], nodes[4], nodes[5]);
+        *cost += best.delta;
+        log_trace("3-opt improved solution: new cost: %f", *cost);
+
+        // wake up the endpoints of the changed edges
+        for(int q=0; q<6; q++){
+            ref_wake(queue, changed, nodes[q]);
+        }
+    }
+
+    return e;
+}
+
+ERROR_CODE ref_lk(instance* inst, tsp_solution* solution){
+
+    // re-initialize cost
+    solution->cost = 0;
+    for(int i=0; i<inst->nnodes; i++){
+        solution->cost += tsp_get_cost(inst, i, solution->path[i]);
+    }
+
+    tour t;
+    if(!err_ok(tour_init(&t, inst->nnodes))){
+        log_error("code %d : Error in tour allocation", RESOURCE_EXHAUSTED);
+        return RESOURCE_EXHAUSTED;
+    }
+    tour_from_successors(&t, solution->path);
+
+    ERROR_CODE e = ref_lk_tour(inst, &t, &solution->cost);
+
+    tour_to_successors(&t, solution->path);
+    tour_free(&t);
+
+    ERROR_CODE error = tsp_update_best_solution(inst, solution);
+    if(!err_ok(error)){
+        log_error("code %d : Error in Lin-Kernighan solution update", error);
+    }
+
+    return e;
+}
+
+#define LK_ALTERNATIVES 5         // alternatives at the root of the search tree
+
+// alternatives tried at each level of the search tree, 1 below
+static const int lk_breadth[LK_BREADTH_LEVELS] = {LK_ALTERNATIVES, 3, 2};
+
+/**
+ * @brief State of the Lin-Kernighan move being built from t1
+ */
+typedef struct {
+    instance* inst;
+    tour* t;
+    int t1;
+    int depth;                          // exchanges applied to the tour
+    int flips[LK_MAX_DEPTH][3];         // t2, t3, t4 of each exchange
+    double best_gain;                   // best gain of a closed tour
+    int best_depth;                     // exchanges giving best_gain
+} lk_search;
+
+/**
+ * @brief Whether edge (a, b) has been added or removed by the current move
+ */
+static bool lk_touched(const lk_search* s, int a, int b, bool added){
+    for(int l=0; l<s->depth; l++){
+        int x = added ? s->flips[l][0] : s->flips[l][1];
+        int y = added ? s->flips[l][1] : s->flips[l][2];
+        if((x == a && y == b) || (x == b && y == a)){
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Lower bound on the cost of an edge from a to one of its candidates
+ */
+static inline double lk_nearest(instance* inst, int a){
+    const candidate_list* cl = &inst->candidates;
+    if(cl->type == CAND_NONE || cand_count(cl, a) == 0){
+        return 0;
+    }
+    if(cl->type != CAND_ALPHA){
+        return tsp_get_cost(inst, a, cand_neighbors(cl, a)[0]);
+    }
+
+    double nearest = __DBL_MAX__;
+    for(int k=0; k<cand_count(cl, a); k++){
+        nearest = fmin(nearest, tsp_get_cost(inst, a, cand_neighbors(cl, a)[k]));
+    }
+    return nearest;
+}
+
+/**
+ * @brief Whether the next level of the move can improve on the best gain, checked before applying
+ * the exchange of t2, t3, t4: it reverses the path from t2 to t4 walking in direction dir
+ */
+static bool lk_lookahead(const lk_search* s, int dir, int t2, int t3, int t4, double g2){
+    instance* inst = s->inst;
+    const tour* t = s->t;
+    int t1 = s->t1;
+
+    const candidate_list* cl = &inst->candidates;
+    bool use_candidates = cl->type != CAND_NONE;
+    bool sorted = use_candidates && cl->type != CAND_ALPHA;
+    const int* neighbors = use_candidates ? cand_neighbors(cl, t4) : NULL;
+    int count = use_candidates ? cand_count(cl, t4) : inst->nnodes;
+
+    for(int k=0; k<count; k++){
+        int x = use_candidates ? neighbors[k] : k;
+        if(x == t1 || x == t4){
+            continue;
+        }
+
+        double g3 = g2 - tsp_get_cost(inst, t4, x);
+        if(g3 <= s->best_gain){
+            if(sorted){
+                break;
+            }
+            continue;
+        }
+
+        // node before x, walking in direction dir, once the path t2..t4 is reversed
+        int y;
+        if(x == t3){
+            y = t2;
+        }else if(ref_between(t, dir, t2, x, t4)){
+            y = ref_step(t, dir, x);
+        }else{
+            y = ref_step(t, 1 - dir, x);
+        }
+        if(y == t4){
+            continue;
+        }
+
+        g3 += tsp_get_cost(inst, x, y);
+        if(g3 - tsp_get_cost(inst, y, t1) > s->best_gain){
+            return true;
+        }
+        if(s->depth + 2 < LK_MAX_DEPTH && g3 - lk_nearest(inst, y) > s->best_gain){
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Extends the move with edge (t1, t2) open and gain g: adds (t2, t3), removes (t3, t4)
+ * and closes with (t4, t1), as one 2opt move. Returns true once an improving move is found
+ */
+static bool lk_step(lk_search* s, int t2, double g){
+    instance* inst = s->inst;
+    tour* t = s->t;
+    int t1 = s->t1;
+    int dir = tour_next(t, t1) == t2 ? 0 : 1;
+
+    const candidate_list* cl = &inst->candidates;
+    bool use_candidates = cl->type != CAND_NONE;
+    bool sorted = use_candidates && cl->type != CAND_ALPHA;
+    const int* neighbors = use_candidates ? cand_neighbors(cl, t2) : NULL;
+    int count = use_candidates ? cand_count(cl, t2) : inst->nnodes;
+
+    // alternatives by d(t3, t4) - d(t2, t3), best first
+    int breadth = s->depth < LK_BREADTH_LEVELS ? lk_breadth[s->depth] : 1;
+    int alt_t3[LK_ALTERNATIVES], alt_t4[LK_ALTERNATIVES];
+    double alt_score[LK_ALTERNATIVES];
+    int nalt = 0;
+
+    for(int k=0; k<count; k++){
+        int t3 = use_candidates ? neighbors[k] : k;
+        if(t3 == t1 || t3 == t2){
+            continue;
+        }
+
+        // gain criterion: the partial gain stays above the best closed one
+        double g1 = g - tsp_get_cost(inst, t2, t3);
+        if(g1 <= s->best_gain){
+            if(sorted){
+                break;
+            }
+            continue;
+        }
+
+        int t4 = dir == 0 ? tour_prev(t, t3) : tour_next(t, t3);
+        if(t4 == t2 || lk_touched(s, t2, t3, false) || lk_touched(s, t3, t4, true)){
+            continue;
+        }
+
+        double score = tsp_get_cost(inst, t3, t4) - tsp_get_cost(inst, t2, t3);
+        int pos = nalt < breadth ? nalt++ : breadth;
+        while(pos > 0 && alt_score[pos - 1] < score){
+            if(pos < breadth){
+                alt_t3[pos] = alt_t3[pos - 1];
+                alt_t4[pos] = alt_t4[pos - 1];
+                alt_score[pos] = alt_score[pos - 1];
+            }
+            pos--;
+        }
+        if(pos < breadth){
+            alt_t3[pos] = t3;
+            alt_t4[pos] = t4;
+            alt_score[pos] = score;
+        }
+    }
+
+    for(int a=0; a<nalt; a++){
+        int t3 = alt_t3[a];
+        int t4 = alt_t4[a];
+
+        double g2 = g - tsp_get_cost(inst, t2, t3) + tsp_get_cost(inst, t3, t4);
+        double closed = g2 - tsp_get_cost(inst, t4, t1);
+
+        // the exchange is applied only if it closes a better tour or the next level looks promising
+        bool deeper = s->depth + 1 < LK_MAX_DEPTH && lk_lookahead(s, dir, t2, t3, t4, g2);
+        if(closed <= s->best_gain && !deeper){
+            continue;
+        }
+
+        // remove (t1, t2), (t4, t3) and add (t1, t4), (t2, t3)
+        tour_swap_edges(t, t1, t2, t4, t3);
+        int* flip = s->flips[s->depth++];
+        flip[0] = t2; flip[1] = t3; flip[2] = t4;
+
+        if(closed > s->best_gain){
+            s->best_gain = closed;
+            s->best_depth = s->depth;
+        }
+
+        if(deeper){
+            lk_step(s, t4, g2);
+        }
+
+        if(s->best_gain > -EPSILON){
+            return true;
+        }
+
+        // backtrack: (t1, t4) and (t2, t3) go back to (t1, t2) and (t4, t3)
+        s->depth--;
+        tour_swap_edges(t, t1, t4, t2, t3);
+    }
+
+    return false;
+}
+
+ERROR_CODE ref_lk_tour(instance* inst, tour* t, double* cost){
+    return ref_search_all(inst, t, cost, ref_lk_queue);
+}
+
+ERROR_CODE ref_lk_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed){
+    ERROR_CODE e = OK;
+    int n = inst->nnodes;
+    if(n < 8){
+        return ref_2opt_queue(inst, t, cost, queue, changed);
+    }
+
+    lk_search s = { .inst = inst, .t = t };
+
+    // a Lin-Kernighan move is a deep search, the clock is read more often
+    int countdown = DEADLINE_PERIOD / 4;
+    while(queue->size > 0){
+        // see if it exceeds the time limit
+        if(deadline_poll(&inst->deadline, &countdown, DEADLINE_PERIOD / 4)){
+            log_debug("time limit exceeded");
+            e = DEADLINE_EXCEEDED;
+            break;
+        }
+
+        int t1 = ref_queue_pop(queue);
+
+        // the first removed edge is either of the two at t1
+        bool improved = false;
+        for(int dir=0; dir<2 && !improved; dir++){
+            int t2 = dir == 0 ? tour_next(t, t1) : tour_prev(t, t1);
+
+            s.t1 = t1;
+            s.depth = 0;
+            s.best_gain = -EPSILON;
+            s.best_depth = 0;
+            improved = lk_step(&s, t2, tsp_get_cost(inst, t1, t2));
+        }
+
+        if(!improved){
+            continue;
+        }
+
+        // undo the exchanges after the best closed tour
+        while(s.depth > s.best_depth){
+            int* flip = s.flips[--s.depth];
+            tour_swap_edges(t, t1, flip[2], flip[0], flip[1]);
+        }
+
+        *cost -= s.best_gain;
+        log_trace("Lin-Kernighan improved solution: new cost: %f", *cost);
+
+        // wake up the endpoints of the changed edges
+        ref_wake(queue, changed, t1);
+        for(int l=0; l<s.depth; l++){
+            for(int q=0; q<3; q++){
+                ref_wake(queue, changed, s.flips[l][q]);
+            }
+        }
+    }
+
+    return e;
+}
+
+double ref_2opt_once(instance* inst, tour* t, double* cost){
+    ref_2opt_move best = ref_2opt_scan(inst, tour_successors(t), NULL, 0);
+
+    // execute best swap
+    if(best.a != -1 && best.delta < EPSILON){
+        log_debug("best swap is %d, %d: executing swap...", best.a, best.b);
+
+        // reverse the shorter of the paths between the two edges
+        tour_2opt_move(t, best.a, best.b);
+
+        // update solution cost
+        *cost += best.delta;
+        log_info("2-opt improved solution: new cost: %f", *cost);
+        return best.delta;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Scan of the rows [a_begin, a_end) with integer costs: deltas are exact, so a move
+ * improves if its delta is below the ceiling of best->delta, no tolerance is needed
+ */
+static void ref_2opt_scan_rows_int(instance* inst, const int* succ, const char* forbidden, int a_begin, int a_end, ref_2opt_move* best){
+    int n = inst->nnodes;
+    int64_t best_delta = best->delta >= (double) INT64_MAX ? INT64_MAX : (int64_t) ceil(best->delta);
+    int best_a = -1, best_b = -1;
+
+    for (int a = a_begin; a < a_end; a++) {
+        int succ_a = succ[a];
+        if(forbidden != NULL && (forbidden[a] || forbidden[succ_a])){
+            continue;
+        }
+        const int32_t* row_a = inst->int_costs + (size_t)a * n;
+        const int32_t* row_succ_a = inst->int_costs + (size_t)succ_a * n;
+        int64_t cost_a = row_a[succ_a];
+
+        for (int b = a+1; b < n; b++) {
+            int succ_b = succ[b];
+            if (succ_a == succ_b || a == succ_b || b == succ_a){
+                continue;
+            }
+            if(forbidden != NULL && (forbidden[b] || forbidden[succ_b])){
+                continue;
+            }
+
+            int64_t delta = (int64_t)row_a[b] + row_succ_a[succ_b] - cost_a - tsp_get_int_cost(inst, b, succ_b);
+            if (delta < best_delta) {
+                best_delta = delta;
+                best_a = a;
+                best_b = b;
+            }
+        }
+    }
+
+    if(best_a != -1){
+        best->delta = (double) best_delta;
+        best->a = best_a;
+        best->b = best_b;
+    }
+}
+
+/**
+ * @brief Scan of the rows [a_begin, a_end) of the 2opt neighborhood
+ */
+static void ref_2opt_scan_rows(instance* inst, const int* succ, const char* forbidden, int a_begin, int a_end, ref_2opt_move* best){
+    // rows of the dense matrix are scanned several b at a time
+    if(forbidden == NULL && inst->costs_mode == COSTS_MATRIX){
+        for (int a = a_begin; a < a_end; a++) {
+            int b = simd_2opt_row(inst->costs, inst->nnodes, succ, a, a+1, &best->delta);
+            if(b != -1){
+                best->a = a;
+                best->b = b;
+            }
+        }
+        return;
+    }
+
+    if(inst->costs_mode == COSTS_INT32){
+        ref_2opt_scan_rows_int(inst, succ, forbidden, a_begin, a_end, best);
+        return;
+    }
+
+    for (int a = a_begin; a < a_end; a++) {
+        int succ_a = succ[a]; //successor of a
+        if(forbidden != NULL && (forbidden[a] || forbidden[succ_a])){
+            continue;
+        }
+        double cost_a = tsp_get_cost(inst, a, succ_a);
+
         for (int b = a+1; b < inst->nnodes; b++) {
-            int succ_a = solution->path[a]; //successor of a
-            int succ_b = solution->path[b]; //successor of b
-            
+            int succ_b = succ[b]; //successor of b
+
             // Skip non valid configurations
             if (succ_a == succ_b || a == succ_b || b == succ_a){
                 continue;
             }
 
+            if(forbidden != NULL && (forbidden[b] || forbidden[succ_b])){
+                continue;
+            }
+
             // Compute the delta. If < 0 it means there is a crossing
-            double current_cost = tsp_get_cost(inst, a, succ_a) + tsp_get_cost(inst, b, succ_b);
+            double current_cost = cost_a + tsp_get_cost(inst, b, succ_b);
             double swapped_cost = tsp_get_cost(inst, a, b) + tsp_get_cost(inst, succ_a, succ_b);
             double delta = swapped_cost - current_cost;
-            if (delta < best_delta) {
-                best_delta = delta;
-                best_swap[0] = a;
-                best_swap[1] = b;
+            if (delta < best->delta) {
+                best->delta = delta;
+                best->a = a;
+                best->b = b;
             }
         }
     }
+}
 
+typedef struct {
+    instance* inst;
+    const int* succ;
+    const char* forbidden;
+    const int* rows;            // worker w scans the rows [rows[w], rows[w+1])
+    ref_2opt_move* best;        // best move of each worker
+} ref_2opt_scan_job;
 
-    // execute best swap
+static void ref_2opt_scan_task(void* ctx, int thread_id, int nthreads){
+    (void) nthreads;
+    ref_2opt_scan_job* job = (ref_2opt_scan_job*) ctx;
+    ref_2opt_scan_rows(job->inst, job->succ, job->forbidden, job->rows[thread_id], job->rows[thread_id + 1], &job->best[thread_id]);
+}
 
-    if(best_delta < EPSILON){
-        int a = best_swap[0];
-        int b = best_swap[1];
-        log_debug("best swap is %d, %d: executing swap...", a, b);
-        int succ_a = solution->path[a]; //successor of a
-        int succ_b = solution->path[b]; //successor of b
-                    
-        //Reverse the path from the b to the successor of a
-        ref_reverse_path(inst, a, succ_a, b, succ_b, prev, solution->path);
+ref_2opt_move ref_2opt_scan(instance* inst, const int* succ, const char* forbidden, double limit){
+    int n = inst->nnodes;
+    ref_2opt_move best = {limit, -1, -1};
 
-        // update solution cost
-        solution->cost += best_delta;
-        log_info("2-opt improved solution: new cost: %f", solution->cost);
+    int nthreads = n < REF_PARALLEL_NODES ? 1 : tsp_costs_threads(inst);
+    if(nthreads > n - 1){
+        nthreads = n - 1;
+    }
+    int* rows = nthreads > 1 ? (int*) malloc((nthreads + 1) * sizeof(int)) : NULL;
+    ref_2opt_move* moves = nthreads > 1 ? (ref_2opt_move*) malloc(nthreads * sizeof(ref_2opt_move)) : NULL;
+    if(rows == NULL || moves == NULL){
+        free(rows);
+        free(moves);
+        ref_2opt_scan_rows(inst, succ, forbidden, 0, n - 1, &best);
+        return best;
+    }
+
+    // row a has n - 1 - a pairs: cut the triangle where the running count reaches w / nthreads of the pairs
+    double pairs = (double) n * (n - 1) / 2;
+    double done = 0;
+    int w = 1;
+    rows[0] = 0;
+    for(int a = 0; a < n - 1 && w < nthreads; a++){
+        done += n - 1 - a;
+        while(w < nthreads && done >= pairs * w / nthreads){
+            rows[w++] = a + 1;
+        }
+    }
+    while(w <= nthreads){
+        rows[w++] = n - 1;
+    }
+
+    for(int i = 0; i < nthreads; i++){
+        moves[i] = best;
+    }
+
+    ref_2opt_scan_job job = {inst, succ, forbidden, rows, moves};
+    threads_run(nthreads, ref_2opt_scan_task, &job);
+
+    // chunks are in increasing a, so a strict comparison keeps the smallest (a, b) among ties
+    for(int i = 0; i < nthreads; i++){
+        if(moves[i].a != -1 && moves[i].delta < best.delta){
+            best = moves[i];
+        }
     }
 
-    free(prev);
+    free(rows);
+    free(moves);
+
+    return best;
+}
+
+void ref_oropt_move(tour* t, int p, int s1, int s2, int nx, int x, int y, bool reversed){
+    // as the 3opt reconnections of edges (p, s1), (s2, nx) and (x, y), made of 2opt moves
+    if(reversed){
+        tour_swap_edges(t, s2, nx, x, y);
+        tour_swap_edges(t, p, s1, nx, y);
+    }else{
+        tour_swap_edges(t, p, s1, s2, nx);
+        tour_swap_edges(t, s1, nx, x, y);
+        tour_swap_edges(t, p, s2, nx, y);
+    }
+}
 
-    return best_delta;
+double ref_3opt_delta(instance* inst, int reconnection, int i, int succ_i, int j, int succ_j, int k, int succ_k){
+    double removed = tsp_get_cost(inst, i, succ_i) + tsp_get_cost(inst, j, succ_j) + tsp_get_cost(inst, k, succ_k);
+    double added;
+    switch (reconnection){
+        case 1:
+            added = tsp_get_cost(inst, k, i) + tsp_get_cost(inst, succ_k, succ_i) + tsp_get_cost(inst, j, succ_j);
+            break;
+        case 2:
+            added = tsp_get_cost(inst, j, k) + tsp_get_cost(inst, succ_j, succ_k) + tsp_get_cost(inst, i, succ_i);
+            break;
+        case 3:
+            added = tsp_get_cost(inst, i, j) + tsp_get_cost(inst, succ_i, succ_j) + tsp_get_cost(inst, k, succ_k);
+            break;
+        case 4:
+            added = tsp_get_cost(inst, i, j) + tsp_get_cost(inst, succ_i, k) + tsp_get_cost(inst, succ_j, succ_k);
+            break;
+        case 5:
+            added = tsp_get_cost(inst, i, k) + tsp_get_cost(inst, succ_k, j) + tsp_get_cost(inst, succ_i, succ_j);
+            break;
+        case 6:
+            added = tsp_get_cost(inst, i, succ_j) + tsp_get_cost(inst, succ_i, succ_k) + tsp_get_cost(inst, j, k);
+            break;
+        case 7:
+            added = tsp_get_cost(inst, i, succ_j) + tsp_get_cost(inst, k, succ_i) + tsp_get_cost(inst, j, succ_k);
+            break;
+        default:
+            added = removed;
+            break;
+    }
 
+    return added - removed;
 }
 
-void ref_reverse_path(instance *inst, int a, int succ_a, int b, int succ_b, int *prev, int* solution_path) {
-    //Swap the 2 edges
-    solution_path[a] = b;
-    solution_path[succ_a] = succ_b;
+// https://tsp-basics.blogspot.com/2017/03/3-opt-move.html
+// every case is a sequence of 2opt moves, so it works in both directions of the tour
+ERROR_CODE makeMove(instance *inst, tour* t, int bestCase, int i, int succ_i, int j, int succ_j, int k, int succ_k) {
+    (void) inst;
+    ERROR_CODE e = OK;
+    switch (bestCase){
+        case 1: 
+            log_debug("case 1");
+
+            // invert segment a
+            tour_swap_edges(t, k, succ_k, i, succ_i);
 
-    // reverse path from b to succ_a
-    int currnode = b;
-    while (1) {
-        int node = prev[currnode];
-        solution_path[currnode] = node;
-        currnode = node;
-        if (node == succ_a) {
             break;
-        }
+        case 2:
+            log_debug("case 2");
+            
+            // invert segment c
+            tour_swap_edges(t, j, succ_j, k, succ_k);
+
+            break;
+        case 3:
+            log_debug("case 3");
+            
+            // invert segment b
+            tour_swap_edges(t, i, succ_i, j, succ_j);
+
+            break;
+        case 4:
+            // inverts segments b and c
+            log_debug("case 4");
+            tour_swap_edges(t, i, succ_i, j, succ_j);
+            tour_swap_edges(t, succ_i, succ_j, k, succ_k);
+
+            break;
+        case 5:
+            // inverts segments a and b
+            log_debug("invert segment a and b");
+            tour_swap_edges(t, i, succ_i, j, succ_j);
+            tour_swap_edges(t, k, succ_k, i, j);
+
+            break;
+        case 6:
+            // inverts segments a and c
+            log_debug("invert segment a and c");
+            tour_swap_edges(t, j, succ_j, k, succ_k);
+            tour_swap_edges(t, i, succ_i, succ_j, succ_k);
+
+            break;
+        case 7:
+            log_debug("case 7");
+
+            // move segment b before segment c: invert b, invert c, invert both
+            tour_swap_edges(t, i, succ_i, j, succ_j);
+            tour_swap_edges(t, succ_i, succ_j, k, succ_k);
+            tour_swap_edges(t, i, j, succ_j, succ_k);
+
+            break;
+        
+        default:
+            e = INVALID_ARGUMENT;
+            break;
     }
 
-    for (int k = 0; k < inst->nnodes; k++) {
-        prev[solution_path[k]] = k;
+    return e;
+}
+
+ERROR_CODE ref_queue_init(ref_queue* queue, int nnodes){
+    queue->nodes = (int*) malloc(nnodes * sizeof(int));
+    queue->active = (bool*) calloc(nnodes, sizeof(bool));
+    queue->capacity = nnodes;
+    queue->head = 0;
+    queue->size = 0;
+    if(queue->nodes == NULL || queue->active == NULL){
+        ref_queue_free(queue);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    return OK;
+}
+
+void ref_queue_fill(ref_queue* queue, const tour* t){
+    ref_queue_clear(queue);
+    for(int i=0, node=0; i<queue->capacity; i++, node=tour_next(t, node)){
+        ref_queue_push(queue, node);
+    }
+}
+
+void ref_queue_clear(ref_queue* queue){
+    while(queue->size > 0){
+        ref_queue_pop(queue);
     }
+    queue->head = 0;
+}
+
+void ref_queue_free(ref_queue* queue){
+    free(queue->nodes);
+    free(queue->active);
+    queue->nodes = NULL;
+    queue->active = NULL;
+    queue->capacity = 0;
+    queue->size = 0;
 }
@@ -13,6 +13,41 @@
  */
 #include "../tsp.h"
 
+#define OROPT_MAX_SEGMENT 3     // longest segment moved by Or-opt
+#define LK_MAX_DEPTH 50         // most edge exchanges in one Lin-Kernighan move
+#define LK_BREADTH_LEVELS 3     // levels of the Lin-Kernighan search tree with alternatives
+#define REF_PARALLEL_NODES 2000 // smallest instance on which full 2opt scans are split among threads
+
+/**
+ * @brief Best move of a full 2opt scan: edges (a, succ a) and (b, succ b) become (a, b) and (succ a, succ b)
+ * 
+ */
+typedef struct {
+    double delta;
+    int a;                      // -1 if no move was found
+    int b;
+} ref_2opt_move;
+
+/**
+ * @brief Circular FIFO of the active nodes of a local search, a node is in it at most once.
+ * Nodes whose edges did not change are not looked at again (don't-look bits)
+ * 
+ */
+typedef struct {
+    int* nodes;
+    bool* active;               // active[node] if node is in the queue
+    int capacity;               // number of nodes
+    int head;
+    int size;
+} ref_queue;
+
+/**
+ * @brief Local search that takes the nodes to look at from queue until it is empty. The endpoints
+ * of every changed edge are queued again and, if changed is not NULL, also pushed in changed
+ * 
+ */
+typedef ERROR_CODE (*ref_local_search)(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed);
+
 /**
  * @brief 2opt refinment algorithm
  * 
@@ -22,6 +57,154 @@
  */
 ERROR_CODE ref_2opt(instance* inst, tsp_solution* solution);
 
+/**
+ * @brief 2opt refinment of a tour, without updating the best solution.
+ * Moves are selected as set by options_t.twoopt
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_2opt_tour(instance* inst, tour* t, double* cost);
+
+/**
+ * @brief First-improvement 2opt: nodes are taken from an active queue and the best move
+ * around the first node that has one is applied. Only the endpoints of applied moves are
+ * queued again (don't-look bits). Moves are searched among the candidate neighbors, if available
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_2opt_first(instance* inst, tour* t, double* cost);
+
+/**
+ * @brief 2opt of ref_2opt_first from the nodes in queue only, e.g. the endpoints of a kick
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @param queue active nodes, empty on return unless the time limit is exceeded
+ * @param changed if not NULL, receives the endpoints of the changed edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_2opt_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed);
+
+/**
+ * @brief Best-improvement 2opt behind the interface of ref_2opt_queue, for TWOOPT_BEST in VNS: a non
+ * empty queue triggers full scans until no move improves, the queue is not looked at node by node
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @param queue active nodes, emptied on return
+ * @param changed if not NULL, receives the endpoints of the changed edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_2opt_best_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed);
+
+/**
+ * @brief Or-opt refinment algorithm: moves segments of 1 to OROPT_MAX_SEGMENT nodes,
+ * possibly reversed, next to one of the candidate neighbors of their endpoints
+ * 
+ * @param inst tsp instance
+ * @param solution solution struct
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_oropt(instance* inst, tsp_solution* solution);
+
+/**
+ * @brief Or-opt refinment of a tour, without updating the best solution.
+ * Nodes are taken from an active queue with don't-look bits, each move is evaluated in O(1)
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_oropt_tour(instance* inst, tour* t, double* cost);
+
+/**
+ * @brief Or-opt of ref_oropt_tour from the nodes in queue only, e.g. the endpoints of a kick
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @param queue active nodes, empty on return unless the time limit is exceeded
+ * @param changed if not NULL, receives the endpoints of the changed edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_oropt_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed);
+
+/**
+ * @brief 3opt refinment algorithm
+ * 
+ * @param inst tsp instance
+ * @param solution solution struct
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_3opt(instance* inst, tsp_solution* solution);
+
+/**
+ * @brief 3opt refinment of a tour, without updating the best solution. Nodes are taken from
+ * an active queue with don't-look bits; the other two removed edges are reached through the
+ * candidate neighbors of the endpoints and all seven reconnections are evaluated
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_3opt_tour(instance* inst, tour* t, double* cost);
+
+/**
+ * @brief 3opt of ref_3opt_tour from the nodes in queue only, e.g. the endpoints of a kick
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @param queue active nodes, empty on return unless the time limit is exceeded
+ * @param changed if not NULL, receives the endpoints of the changed edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_3opt_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed);
+
+/**
+ * @brief Lin-Kernighan refinment algorithm
+ * 
+ * @param inst tsp instance
+ * @param solution solution struct
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_lk(instance* inst, tsp_solution* solution);
+
+/**
+ * @brief Lin-Kernighan refinment of a tour, without updating the best solution.
+ * Each move is a sequence of up to LK_MAX_DEPTH sequential exchanges made of 2opt moves
+ * (Or-LK): the first LK_BREADTH_LEVELS levels try several candidate neighbors and backtrack,
+ * deeper levels follow only the best one. Nodes are taken from an active queue with don't-look bits
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_lk_tour(instance* inst, tour* t, double* cost);
+
+/**
+ * @brief Lin-Kernighan of ref_lk_tour from the nodes in queue only, e.g. the endpoints of a kick
+ * 
+ * @param inst tsp instance
+ * @param t tour to refine
+ * @param cost cost of the tour, updated with the moves
+ * @param queue active nodes, empty on return unless the time limit is exceeded
+ * @param changed if not NULL, receives the endpoints of the changed edges
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_lk_queue(instance* inst, tour* t, double* cost, ref_queue* queue, ref_queue* changed);
+
 //================================================================================
 // UTILS
 //================================================================================
@@ -30,20 +213,116 @@ ERROR_CODE ref_2opt(instance* inst, tsp_solution* solution);
  * @brief Util for one 2opt move
  * 
  * @param inst tsp instance
- * @param solution_path solution struct
+ * @param t tour, the best move is applied to it
+ * @param cost cost of the tour, updated with the move
  * @return double best delta
  */
-double ref_2opt_once(instance* inst, tsp_solution* solution);
+double ref_2opt_once(instance* inst, tour* t, double* cost);
+
+/**
+ * @brief Util to find the best 2opt move among all pairs a < b. With REF_PARALLEL_NODES nodes or more
+ * the rows a are split in chunks with the same number of pairs among the threads; each thread keeps its
+ * best move and ties go to the smallest (a, b), so the result is the one of the sequential scan
+ * 
+ * @param inst tsp instance
+ * @param succ successor of each node
+ * @param forbidden if not NULL, moves that touch a node with forbidden[node] != 0 are skipped
+ * @param limit only moves with delta < limit are considered
+ * @return ref_2opt_move 
+ */
+ref_2opt_move ref_2opt_scan(instance* inst, const int* succ, const char* forbidden, double limit);
 
 /**
- * @brief Util to reverse a path from start_node to end_node in solution_path
+ * @brief Util to move the segment s1..s2 between x and y, where p and nx are the nodes around the
+ * segment and y follows x on the path from nx to p. The segment is reversed when it goes x-s2..s1-y
+ * 
+ * @param t tour
+ * @param p node before s1
+ * @param s1 first node of the segment
+ * @param s2 last node of the segment
+ * @param nx node after s2
+ * @param x 
+ * @param y 
+ * @param reversed 
+ */
+void ref_oropt_move(tour* t, int p, int s1, int s2, int nx, int x, int y, bool reversed);
+
+/**
+ * @brief Util for the cost change of a 3opt reconnection of edges (i, succ_i), (j, succ_j)
+ * and (k, succ_k), met in this order along the tour. Cases as in makeMove
+ * 
+ * @return double delta
+ */
+double ref_3opt_delta(instance* inst, int reconnection, int i, int succ_i, int j, int succ_j, int k, int succ_k);
+
+/**
+ * @brief Util to apply a 3opt reconnection as a sequence of 2opt moves:
+ * 1-3 reverse one segment (2opt), 4-6 reverse two segments, 7 swaps two segments
  * 
  * @param inst tsp instance
- * @param start_node 
- * @param end_node 
- * @param prev array path before the 2opt move
- * @param solution_path path that will be modified
+ * @param t tour
+ * @param bestCase reconnection, from 1 to 7
+ * @return ERROR_CODE INVALID_ARGUMENT for an unknown case
+ */
+ERROR_CODE makeMove(instance *inst, tour* t, int bestCase, int i, int succ_i, int j, int succ_j, int k, int succ_k);
+
+/**
+ * @brief Util to allocate an empty active queue
+ * 
+ * @param queue 
+ * @param nnodes 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE ref_queue_init(ref_queue* queue, int nnodes);
+
+/**
+ * @brief Util to queue every node, in tour order
+ * 
+ * @param queue 
+ * @param t 
+ */
+void ref_queue_fill(ref_queue* queue, const tour* t);
+
+/**
+ * @brief Util to queue a node, if it is not already in the queue
+ * 
+ * @param queue 
+ * @param node 
+ */
+static inline void ref_queue_push(ref_queue* queue, int node){
+    if(!queue->active[node]){
+        queue->active[node] = true;
+        queue->nodes[(queue->head + queue->size) % queue->capacity] = node;
+        queue->size++;
+    }
+}
+
+/**
+ * @brief Util to take the first node of a non empty queue
+ * 
+ * @param queue 
+ * @return int 
+ */
+static inline int ref_queue_pop(ref_queue* queue){
+    int node = queue->nodes[queue->head];
+    queue->head = (queue->head + 1) % queue->capacity;
+    queue->size--;
+    queue->active[node] = false;
+    return node;
+}
+
+/**
+ * @brief Util to empty the queue
+ * 
+ * @param queue 
+ */
+void ref_queue_clear(ref_queue* queue);
+
+/**
+ * @brief Util to free the active queue
+ * 
+ * @param queue 
  */
-void ref_reverse_path(instance *inst, int a, int succ_a, int b, int succ_b, int *prev, int* solution_path);
+void ref_queue_free(ref_queue* queue);
 
 #endif
@@ -15,11 +15,11 @@ return_struct* runTSP(const char* path, int seed, int time_limit, algorithms alg
     // start options
 
     if(seed != -1){
-        inst.options_t.seed = seed;
+        tsp_set_seed(&inst, seed);
     }
 
     if(time_limit > 0){
-        inst.options_t.timelimit = time_limit;
+        tsp_set_timelimit(&inst, time_limit);
     }
 
     inst.alg = alg;
@@ -33,7 +33,7 @@ return_struct* runTSP(const char* path, int seed, int time_limit, algorithms alg
                 tsp_handlefatal(&inst);
             }
 
-    inst.options_t.inputfile = (char*) calloc(strlen(path), sizeof(char));
+    inst.options_t.inputfile = (char*) calloc(strlen(path) + 1, sizeof(char));
     strcpy(inst.options_t.inputfile, path);
 
 
@@ -82,7 +82,7 @@ return_struct* runTSP(const char* path, int seed, int time_limit, algorithms alg
         break;
     case ALG_TABU_SEARCH:
         log_info("running Tabu Search");
-        e = mh_TabuSearch(&inst, POL_LINEAR);
+        e = mh_TabuSearch(&inst, inst.options_t.tabu_policy);
         if(!err_ok(e)){
             log_fatal("tabu search did not finish correctly");
             tsp_handlefatal(&inst);
@@ -100,6 +100,36 @@ return_struct* runTSP(const char* path, int seed, int time_limit, algorithms alg
         printf("VNS: %f\n", inst.best_solution.cost);
         tsp_plot_solution(&inst);
         break;
+    case ALG_3OPT:
+        log_info("running 3OPT");
+        e = h_greedy_3opt(&inst);
+        if(!err_ok(e)){
+            log_fatal("3opt did not finish correctly");
+            tsp_handlefatal(&inst);
+        } 
+        printf("Greedy from %d + 3-opt: %f\n", inst.starting_node, inst.best_solution.cost);
+        tsp_plot_solution(&inst);
+        break;
+    case ALG_2OPT:
+        log_info("running 2OPT");
+        e = h_greedy_2opt_single(&inst);
+        if(!err_ok(e)){
+            log_fatal("2opt did not finish correctly");
+            tsp_handlefatal(&inst);
+        } 
+        printf("Greedy from %d + 2-opt: %f\n", inst.starting_node, inst.best_solution.cost);
+        tsp_plot_solution(&inst);
+        break;
+    case ALG_LK:
+        log_info("running LK");
+        e = h_greedy_lk(&inst);
+        if(!err_ok(e)){
+            log_fatal("Lin-Kernighan did not finish correctly");
+            tsp_handlefatal(&inst);
+        } 
+        printf("Greedy from %d + Lin-Kernighan: %f\n", inst.starting_node, inst.best_solution.cost);
+        tsp_plot_solution(&inst);
+        break;
     default:
         log_error("cannot run any algorithm");
         break;
@@ -1,12 +1,361 @@
 #include "tsp.h"
 
+//================================================================================
+// COSTS UTILS
+//================================================================================
+
+/**
+ * @brief TSPLIB EUC_2D distance, nint of the euclidean one computed in double precision
+ */
+static inline double costs_nint(double dx, double dy){
+    return (int)(sqrt(dx * dx + dy * dy) + 0.5);
+}
+
+/**
+ * @brief Euclidean distance between nodes i and j, same rounding as the cost matrix
+ */
+static double costs_distance(instance* inst, int i, int j){
+    double dx = inst->points[j].x - inst->points[i].x;
+    double dy = inst->points[j].y - inst->points[i].y;
+    if(inst->options_t.integer_costs){
+        return costs_nint(dx, dy);
+    }
+    return sqrtf(dx * dx + dy * dy);
+}
+
+/**
+ * @brief Position of edge i-j in the packed upper triangle, i != j
+ */
+static inline size_t costs_packed_index(int nnodes, int i, int j){
+    if(i > j){
+        int tmp = i;
+        i = j;
+        j = tmp;
+    }
+    return (size_t)i * nnodes - (size_t)i * (i + 1) / 2 + (j - i - 1);
+}
+
+/**
+ * @brief Writes the costs of edges i-j, start <= j < start+len and i < start, in the packed storage in use
+ */
+static inline void costs_store_row(instance* inst, int i, int start, int len, const double* distances){
+    size_t offset = costs_packed_index(inst->nnodes, i, start);
+
+    switch(inst->costs_mode){
+        case COSTS_PACKED:
+            for(int k=0; k<len; k++){
+                inst->packed_costs.f32[offset + k] = (float)distances[k];
+            }
+            break;
+        case COSTS_QUANT16:
+            for(int k=0; k<len; k++){
+                inst->packed_costs.u16[offset + k] = (uint16_t)lround(distances[k] / inst->costs_scale);
+            }
+            break;
+        case COSTS_QUANT32:
+            for(int k=0; k<len; k++){
+                inst->packed_costs.u32[offset + k] = (uint32_t)lround(distances[k] / inst->costs_scale);
+            }
+            break;
+        case COSTS_INT32:
+            for(int k=0; k<len; k++){
+                inst->int_costs[(size_t)i * inst->nnodes + start + k] = (int32_t)distances[k];
+                inst->int_costs[(size_t)(start + k) * inst->nnodes + i] = (int32_t)distances[k];
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * @brief Shared state of the workers computing the costs
+ */
+typedef struct {
+    instance* inst;
+    double* xs;                 // SoA copy of the points for the kernels
+    double* ys;
+    int nblocks;                // number of COSTS_TILE x COSTS_TILE row blocks
+    int next_block;             // next row block to process, updated atomically
+} costs_job;
+
+/**
+ * @brief First-touch initialization: every worker zeroes the rows it owns, so pages
+ * are placed on the memory node of the thread that touched them first
+ */
+static void costs_touch_task(void* ctx, int thread_id, int nthreads){
+    costs_job* job = (costs_job*) ctx;
+    instance* inst = job->inst;
+    size_t n = inst->nnodes;
+
+    for(int b=thread_id; b<job->nblocks; b+=nthreads){
+        int i1 = (b + 1) * COSTS_TILE < inst->nnodes ? (b + 1) * COSTS_TILE : inst->nnodes;
+        for(int i=b*COSTS_TILE; i<i1; i++){
+            if(inst->costs_mode == COSTS_MATRIX){
+                memset(inst->costs + (size_t)i * n, 0, n * sizeof(double));
+                inst->costs[(size_t)i * n + i] = NOT_CONNECTED;
+                continue;
+            }
+            if(inst->costs_mode == COSTS_INT32){
+                memset(inst->int_costs + (size_t)i * n, 0, n * sizeof(int32_t));
+                inst->int_costs[(size_t)i * n + i] = (int32_t)NOT_CONNECTED;
+                continue;
+            }
+
+            if(i == inst->nnodes - 1){
+                continue;
+            }
+            size_t offset = costs_packed_index(inst->nnodes, i, i + 1);
+            size_t len = n - i - 1;
+            switch(inst->costs_mode){
+                case COSTS_PACKED:  memset(inst->packed_costs.f32 + offset, 0, len * sizeof(float)); break;
+                case COSTS_QUANT16: memset(inst->packed_costs.u16 + offset, 0, len * sizeof(uint16_t)); break;
+                case COSTS_QUANT32: memset(inst->packed_costs.u32 + offset, 0, len * sizeof(uint32_t)); break;
+                default: break;
+            }
+        }
+    }
+}
+
+/**
+ * @brief Computes tile (I, J), J >= I, of the upper triangle. The dense matrix gets
+ * the mirrored tile too, copied while the source rows are still in cache
+ */
+static void costs_tile(costs_job* job, int I, int J, double* buffer){
+    instance* inst = job->inst;
+    size_t n = inst->nnodes;
+
+    int i0 = I * COSTS_TILE;
+    int i1 = i0 + COSTS_TILE < inst->nnodes ? i0 + COSTS_TILE : inst->nnodes;
+    int j0 = J * COSTS_TILE;
+    int j1 = j0 + COSTS_TILE < inst->nnodes ? j0 + COSTS_TILE : inst->nnodes;
+
+    for(int i=i0; i<i1; i++){
+        int start = i + 1 > j0 ? i + 1 : j0;
+        if(start >= j1){
+            continue;
+        }
+
+        double* out = inst->costs_mode == COSTS_MATRIX ? inst->costs + (size_t)i * n + start : buffer;
+        if(inst->options_t.integer_costs){
+            for(int j=start; j<j1; j++){
+                out[j - start] = costs_nint(job->xs[j] - job->xs[i], job->ys[j] - job->ys[i]);
+            }
+        }else{
+            simd_distance_row(job->xs + start, job->ys + start, job->xs[i], job->ys[i], j1 - start, out);
+        }
+
+        if(inst->costs_mode != COSTS_MATRIX){
+            costs_store_row(inst, i, start, j1 - start, buffer);
+        }
+    }
+
+    if(inst->costs_mode == COSTS_MATRIX){
+        for(int j=j0; j<j1; j++){
+            int end = j < i1 ? j : i1;
+            for(int i=i0; i<end; i++){
+                inst->costs[(size_t)j * n + i] = inst->costs[(size_t)i * n + j];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Workers grab row blocks from a shared counter: blocks are handed out from the
+ * longest row of the triangle to the shortest, which keeps the load balanced.
+ * The time limit is checked once per tile
+ */
+static void costs_tile_task(void* ctx, int thread_id, int nthreads){
+    (void) thread_id;
+    (void) nthreads;
+    costs_job* job = (costs_job*) ctx;
+    instance* inst = job->inst;
+    double buffer[COSTS_TILE];
+
+    while(true){
+        int I = __atomic_fetch_add(&job->next_block, 1, __ATOMIC_RELAXED);
+        if(I >= job->nblocks){
+            return;
+        }
+
+        for(int J=I; J<job->nblocks; J++){
+            // check that we have not exceed time limit
+            if(deadline_expired(&inst->deadline)){
+                return;
+            }
+
+            costs_tile(job, I, J, buffer);
+        }
+    }
+}
+
+/**
+ * @brief Allocates the storage in use, left untouched for the first-touch initialization.
+ * The quantization step is derived from the bounding box
+ */
+static ERROR_CODE costs_alloc(instance* inst){
+    size_t n = inst->nnodes;
+    size_t npairs = n * (n - 1) / 2;
+    void* mem = NULL;
+
+    switch(inst->costs_mode){
+        case COSTS_MATRIX:
+            inst->costs = (double*) malloc(n * n * sizeof(double));
+            mem = inst->costs;
+            break;
+        case COSTS_PACKED:
+            inst->packed_costs.f32 = (float*) malloc(npairs * sizeof(float));
+            mem = inst->packed_costs.f32;
+            break;
+        case COSTS_QUANT16:
+            inst->packed_costs.u16 = (uint16_t*) malloc(npairs * sizeof(uint16_t));
+            mem = inst->packed_costs.u16;
+            break;
+        case COSTS_QUANT32:
+            inst->packed_costs.u32 = (uint32_t*) malloc(npairs * sizeof(uint32_t));
+            mem = inst->packed_costs.u32;
+            break;
+        case COSTS_INT32:
+            inst->int_costs = (int32_t*) malloc(n * n * sizeof(int32_t));
+            mem = inst->int_costs;
+            break;
+        default:
+            return INVALID_ARGUMENT;
+    }
+
+    if(mem == NULL && npairs > 0){
+        return RESOURCE_EXHAUSTED;
+    }
+
+    if(inst->costs_mode == COSTS_QUANT16 || inst->costs_mode == COSTS_QUANT32){
+        double min_x = __DBL_MAX__, min_y = __DBL_MAX__;
+        double max_x = -__DBL_MAX__, max_y = -__DBL_MAX__;
+        for(int i=0; i<inst->nnodes; i++){
+            min_x = fmin(min_x, inst->points[i].x);
+            max_x = fmax(max_x, inst->points[i].x);
+            min_y = fmin(min_y, inst->points[i].y);
+            max_y = fmax(max_y, inst->points[i].y);
+        }
+
+        // the diagonal of the bounding box bounds every distance, +1 absorbs the sqrtf rounding
+        double max_distance = sqrt((max_x - min_x) * (max_x - min_x) + (max_y - min_y) * (max_y - min_y)) + 1;
+        double levels = inst->costs_mode == COSTS_QUANT16 ? UINT16_MAX : UINT32_MAX;
+        inst->costs_scale = max_distance / levels;
+        log_debug("quantization step: %g", inst->costs_scale);
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Allocates the row cache of the oracle, clamping it to the memory budget
+ */
+static void costs_init_cache(instance* inst){
+    inst->cache.nrows = 0;
+
+    int rows = inst->options_t.cache_rows;
+    if(rows <= 0){
+        return;
+    }
+
+    double row_mb = (double)inst->nnodes * sizeof(double) / (1024.0 * 1024.0);
+    int max_rows = (int)(inst->options_t.memory_budget / row_mb);
+    if(rows > max_rows){
+        log_warn("oracle cache clamped to %d rows by the memory budget", max_rows);
+        rows = max_rows;
+    }
+    if(rows > inst->nnodes){
+        rows = inst->nnodes;
+    }
+    if(rows <= 0){
+        return;
+    }
+
+    inst->cache.tags = (int*) malloc(rows * sizeof(int));
+    inst->cache.pending = (int*) malloc(rows * sizeof(int));
+    inst->cache.rows = (double*) malloc((size_t)rows * inst->nnodes * sizeof(double));
+    if(inst->cache.tags == NULL || inst->cache.pending == NULL || inst->cache.rows == NULL){
+        log_warn("cannot allocate oracle cache, running without it");
+        free(inst->cache.tags);
+        free(inst->cache.pending);
+        free(inst->cache.rows);
+        return;
+    }
+
+    for(int s=0; s<rows; s++){
+        inst->cache.tags[s] = -1;
+        inst->cache.pending[s] = -1;
+    }
+    inst->cache.nrows = rows;
+
+    log_debug("oracle cache of %d rows", rows);
+}
+
+/**
+ * @brief Cost of edge i-j computed on demand, looking up the row cache first
+ */
+static double costs_oracle(instance* inst, int i, int j){
+    if(i == j){
+        return NOT_CONNECTED;
+    }
+
+    cost_cache* cache = &inst->cache;
+    if(cache->nrows == 0){
+        return costs_distance(inst, i, j);
+    }
+
+    int slot = i % cache->nrows;
+    if(cache->tags[slot] == i){
+        return cache->rows[(size_t)slot * inst->nnodes + j];
+    }
+
+    int slot_j = j % cache->nrows;
+    if(cache->tags[slot_j] == j){
+        return cache->rows[(size_t)slot_j * inst->nnodes + i];
+    }
+
+    // admit the row only on its second consecutive miss
+    if(cache->pending[slot] != i){
+        cache->pending[slot] = i;
+        return costs_distance(inst, i, j);
+    }
+
+    double* row = cache->rows + (size_t)slot * inst->nnodes;
+    for(int k=0; k<inst->nnodes; k++){
+        row[k] = k == i ? NOT_CONNECTED : costs_distance(inst, i, k);
+    }
+    cache->tags[slot] = i;
+
+    return row[j];
+}
+
 void tsp_init(instance* inst){
     inst->options_t.graph_random = false;
     inst->options_t.graph_input = false;
-    inst->options_t.timelimit = -1;
-    inst->options_t.seed = 0;
+    tsp_set_seed(inst, 0);
     inst->options_t.tofile = false;
     inst->options_t.k = 10000;
+    inst->options_t.costs_mode = COSTS_AUTO;
+    inst->options_t.integer_costs = false;
+    inst->options_t.memory_budget = DEFAULT_MEMORY_BUDGET;
+    inst->options_t.cache_rows = 0;
+    inst->options_t.threads = threads_available();
+    inst->options_t.candidates = CAND_KNN;
+    inst->options_t.candidates_k = DEFAULT_CANDIDATES;
+    inst->options_t.twoopt = TWOOPT_FIRST;
+    inst->options_t.oropt = false;
+    inst->options_t.vns_ls = LS_2OPT;
+    inst->options_t.vns_count = 0;
+    inst->options_t.vns_adaptive = false;
+    inst->options_t.tabu_policy = POL_LINEAR;
+    inst->options_t.tabu_walkers = 1;
+    inst->options_t.tabu_restart = 0;
+    inst->options_t.parser = PARSER_MMAP;
+    inst->options_t.bin_input = false;
+    inst->options_t.binfile = NULL;
+    inst->options_t.initfile = NULL;
+    inst->options_t.checkpointfile = NULL;
+    inst->options_t.checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
     
     inst->nnodes = -1;
     inst->best_solution.cost = __DBL_MAX__;
@@ -15,10 +364,18 @@ void tsp_init(instance* inst){
 
     inst->points_allocated = false;
     inst->costs_computed = false;
+    inst->costs_mode = COSTS_MATRIX;
+    inst->cache.nrows = 0;
+    inst->candidates.type = CAND_NONE;
+    inst->tree_built = false;
+    inst->binary.map = NULL;
+    inst->checkpoint_time = 0;
+    inst->checkpoint_cost = __DBL_MAX__;
 
     err_setverbosity(NORMAL);
 
-    inst->c = utils_startclock();
+    deadline_init(&inst->deadline);
+    tsp_set_timelimit(inst, -1);
 
 }
 
@@ -42,7 +399,7 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
 
     for(int i=1; i<argc; i++){
 
-        if (strcmp("-f", argv[i]) == 0 || strcmp("-file", argv[i]) == 0){
+        if (strcmp("-f", argv[i]) == 0 || strcmp("-file", argv[i]) == 0 || strcmp("-bin", argv[i]) == 0){
             log_info("parsing input file argument");
 
             if(utils_invalid_input(i, argc, &help)){
@@ -50,6 +407,7 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
                 continue;
             }
 
+            bool binary = strcmp("-bin", argv[i]) == 0;
             const char* path = argv[++i];
 
             if(inst->options_t.graph_random){
@@ -63,10 +421,62 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
                 tsp_handlefatal(inst);
             }
 
-            inst->options_t.inputfile = (char*) calloc(strlen(path), sizeof(char));
+            inst->options_t.inputfile = (char*) calloc(strlen(path) + 1, sizeof(char));
             strcpy(inst->options_t.inputfile, path);
 
             inst->options_t.graph_input = true;
+            inst->options_t.bin_input = binary;
+
+            continue;
+        }
+
+        if(strcmp("-init", argv[i]) == 0 || strcmp("-checkpoint", argv[i]) == 0){
+            log_info("parsing tour file");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            char** file = strcmp("-init", argv[i]) == 0 ? &inst->options_t.initfile : &inst->options_t.checkpointfile;
+            const char* path = argv[++i];
+            free(*file);
+            *file = (char*) calloc(strlen(path) + 1, sizeof(char));
+            strcpy(*file, path);
+
+            continue;
+        }
+
+        if(strcmp("-checkpoint_every", argv[i]) == 0){
+            log_info("parsing checkpoint interval");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            double seconds = atof(argv[++i]);
+            if(seconds < 0){
+                log_warn("checkpoint interval cannot be negative, using default %d s", DEFAULT_CHECKPOINT_INTERVAL);
+                continue;
+            }
+            inst->options_t.checkpoint_interval = seconds;
+
+            continue;
+        }
+
+        if(strcmp("-bin_out", argv[i]) == 0){
+            log_info("parsing binary cache output");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* path = argv[++i];
+            free(inst->options_t.binfile);
+            inst->options_t.binfile = (char*) calloc(strlen(path) + 1, sizeof(char));
+            strcpy(inst->options_t.binfile, path);
 
             continue;
         }
@@ -85,7 +495,7 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
                 log_info("ignoring time limit");
                 continue;
             }
-            inst->options_t.timelimit = t;
+            tsp_set_timelimit(inst, t);
             continue;
         }
 
@@ -97,7 +507,7 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
                 continue;
             }
 
-            inst->options_t.seed = atoi(argv[++i]);
+            tsp_set_seed(inst, atoi(argv[++i]));
             continue;
         }
 
@@ -129,6 +539,15 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
             }else if (strcmp("CPLEX", method) == 0){
                 inst->alg = ALG_CPLEX;
                 log_info("selected CPLEX");
+            }else if (strcmp("3OPT", method) == 0){
+                inst->alg = ALG_3OPT;
+                log_info("selected 3opt algorithm");
+            }else if (strcmp("LK", method) == 0){
+                inst->alg = ALG_LK;
+                log_info("selected Lin-Kernighan algorithm");
+            }else if (strcmp("2OPT", method) == 0){
+                inst->alg = ALG_2OPT;
+                log_info("selected 2opt algorithm");
             }else{
                 log_warn("algorithm not recognized, using greedy as default");
             }
@@ -160,7 +579,7 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
 
             char buffer[40];
             utils_plotname(buffer, 40);
-            inst->options_t.inputfile = (char*) calloc(strlen(buffer), sizeof(char));
+            inst->options_t.inputfile = (char*) calloc(strlen(buffer) + 1, sizeof(char));
             strcpy(inst->options_t.inputfile, buffer);
 
             inst->options_t.graph_random = true;
@@ -180,6 +599,116 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
             continue;
         }
 
+        if(strcmp("-vns_ls", argv[i]) == 0){
+            log_info("parsing VNS local search");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* ls = argv[++i];
+
+            if (strcmp("2OPT", ls) == 0){
+                inst->options_t.vns_ls = LS_2OPT;
+            }else if (strcmp("3OPT", ls) == 0){
+                inst->options_t.vns_ls = LS_3OPT;
+            }else if (strcmp("LK", ls) == 0){
+                inst->options_t.vns_ls = LS_LK;
+            }else{
+                log_warn("VNS local search not recognized, using 2OPT as default");
+            }
+
+            continue;
+        }
+
+        if(strcmp("-vns_nbh", argv[i]) == 0){
+            log_info("parsing VNS neighborhoods");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            // comma separated list, e.g. 2OPT,OROPT,3OPT
+            const char* list = argv[++i];
+            int count = 0;
+            while(*list != '\0'){
+                size_t len = strcspn(list, ",");
+                local_search nbh = LS_2OPT;
+                bool known = true;
+                if(len == 4 && strncmp("2OPT", list, len) == 0){
+                    nbh = LS_2OPT;
+                }else if(len == 5 && strncmp("OROPT", list, len) == 0){
+                    nbh = LS_OROPT;
+                }else if(len == 4 && strncmp("3OPT", list, len) == 0){
+                    nbh = LS_3OPT;
+                }else if(len == 2 && strncmp("LK", list, len) == 0){
+                    nbh = LS_LK;
+                }else{
+                    known = false;
+                }
+
+                if(!known){
+                    log_warn("VNS neighborhood %.*s not recognized, ignoring it", (int) len, list);
+                }else if(count == VNS_MAX_NEIGHBORHOODS){
+                    log_warn("at most %d VNS neighborhoods, ignoring %.*s", VNS_MAX_NEIGHBORHOODS, (int) len, list);
+                }else{
+                    inst->options_t.vns_neighborhoods[count++] = nbh;
+                }
+
+                list += list[len] == ',' ? len + 1 : len;
+            }
+            inst->options_t.vns_count = count;
+
+            continue;
+        }
+
+        if(strcmp("--vns_adaptive", argv[i]) == 0){
+            log_info("VNS neighborhoods will be picked by improvement per CPU time");
+            inst->options_t.vns_adaptive = true;
+            continue;
+        }
+
+        if(strcmp("-tabu_policy", argv[i]) == 0){
+            log_info("parsing tabu search policy");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* policy = argv[++i];
+
+            if (strcmp("FIXED", policy) == 0){
+                inst->options_t.tabu_policy = POL_FIXED;
+            }else if (strcmp("SIZE", policy) == 0){
+                inst->options_t.tabu_policy = POL_SIZE;
+            }else if (strcmp("RANDOM", policy) == 0){
+                inst->options_t.tabu_policy = POL_RANDOM;
+            }else if (strcmp("LINEAR", policy) == 0){
+                inst->options_t.tabu_policy = POL_LINEAR;
+            }else if (strcmp("REACTIVE", policy) == 0){
+                inst->options_t.tabu_policy = POL_REACTIVE;
+            }else{
+                log_warn("tabu policy not recognized, using LINEAR as default");
+            }
+
+            continue;
+        }
+
+        if(strcmp("--integer", argv[i]) == 0){
+            log_info("costs will be TSPLIB EUC_2D integer distances");
+            inst->options_t.integer_costs = true;
+            continue;
+        }
+
+        if(strcmp("--oropt", argv[i]) == 0){
+            log_info("local searches will use Or-opt moves");
+            inst->options_t.oropt = true;
+            continue;
+        }
+
         if(strcmp("-k", argv[i]) == 0){
             log_info("parsing k");
 
@@ -192,6 +721,213 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
             continue;
         }
 
+        if(strcmp("-costs", argv[i]) == 0){
+            log_info("parsing costs storage");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* mode = argv[++i];
+
+            if (strcmp("AUTO", mode) == 0){
+                inst->options_t.costs_mode = COSTS_AUTO;
+            }else if (strcmp("MATRIX", mode) == 0){
+                inst->options_t.costs_mode = COSTS_MATRIX;
+            }else if (strcmp("ORACLE", mode) == 0){
+                inst->options_t.costs_mode = COSTS_ORACLE;
+            }else if (strcmp("PACKED", mode) == 0){
+                inst->options_t.costs_mode = COSTS_PACKED;
+            }else if (strcmp("QUANT16", mode) == 0){
+                inst->options_t.costs_mode = COSTS_QUANT16;
+            }else if (strcmp("QUANT32", mode) == 0){
+                inst->options_t.costs_mode = COSTS_QUANT32;
+            }else if (strcmp("INT32", mode) == 0){
+                inst->options_t.costs_mode = COSTS_INT32;
+                inst->options_t.integer_costs = true;
+            }else{
+                log_warn("costs storage not recognized, using AUTO as default");
+            }
+
+            continue;
+        }
+
+        if(strcmp("-mem", argv[i]) == 0){
+            log_info("parsing memory budget");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            int mb = atoi(argv[++i]);
+            if(mb <= 0){
+                log_warn("memory budget should be greater than 0");
+                log_info("ignoring memory budget");
+                continue;
+            }
+            inst->options_t.memory_budget = mb;
+            continue;
+        }
+
+        if(strcmp("-cache_rows", argv[i]) == 0){
+            log_info("parsing oracle cache rows");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            int rows = atoi(argv[++i]);
+            if(rows < 0){
+                log_warn("cache rows cannot be negative");
+                log_info("ignoring cache rows");
+                continue;
+            }
+            inst->options_t.cache_rows = rows;
+            continue;
+        }
+
+        if(strcmp("-threads", argv[i]) == 0){
+            log_info("parsing number of threads");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            int threads = atoi(argv[++i]);
+            if(threads <= 0){
+                log_warn("number of threads should be greater than 0");
+                log_info("using all available processors");
+                continue;
+            }
+            inst->options_t.threads = threads;
+            continue;
+        }
+
+        if(strcmp("-parser", argv[i]) == 0){
+            log_info("parsing TSPLIB parser");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* type = argv[++i];
+
+            if (strcmp("STDIO", type) == 0){
+                inst->options_t.parser = PARSER_STDIO;
+            }else if (strcmp("MMAP", type) == 0){
+                inst->options_t.parser = PARSER_MMAP;
+            }else{
+                log_warn("parser not recognized, using MMAP as default");
+            }
+
+            continue;
+        }
+
+        if(strcmp("-cand", argv[i]) == 0){
+            log_info("parsing candidate lists");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* type = argv[++i];
+
+            if (strcmp("NONE", type) == 0){
+                inst->options_t.candidates = CAND_NONE;
+            }else if (strcmp("KNN", type) == 0){
+                inst->options_t.candidates = CAND_KNN;
+            }else if (strcmp("QUADRANT", type) == 0){
+                inst->options_t.candidates = CAND_QUADRANT;
+            }else if (strcmp("ALPHA", type) == 0){
+                inst->options_t.candidates = CAND_ALPHA;
+            }else{
+                log_warn("candidate lists not recognized, using KNN as default");
+            }
+
+            continue;
+        }
+
+        if(strcmp("-tabu_walkers", argv[i]) == 0){
+            log_info("parsing number of tabu search walkers");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            int walkers = atoi(argv[++i]);
+            if(walkers <= 0){
+                log_warn("number of walkers should be greater than 0");
+                log_info("ignoring number of walkers");
+                continue;
+            }
+            inst->options_t.tabu_walkers = walkers;
+            continue;
+        }
+
+        if(strcmp("-tabu_restart", argv[i]) == 0){
+            log_info("parsing restart period of tabu search walkers");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            int restart = atoi(argv[++i]);
+            if(restart < 0){
+                log_warn("restart period should not be negative");
+                log_info("ignoring restart period");
+                continue;
+            }
+            inst->options_t.tabu_restart = restart;
+            continue;
+        }
+
+        if(strcmp("-cand_k", argv[i]) == 0){
+            log_info("parsing length of candidate lists");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            int k = atoi(argv[++i]);
+            if(k <= 0){
+                log_warn("length of candidate lists should be greater than 0");
+                log_info("ignoring length of candidate lists");
+                continue;
+            }
+            inst->options_t.candidates_k = k;
+            continue;
+        }
+
+        if(strcmp("-2opt", argv[i]) == 0){
+            log_info("parsing 2opt move selection");
+
+            if(utils_invalid_input(i, argc, &help)){
+                log_warn("invalid input");
+                continue;
+            }
+
+            const char* mode = argv[++i];
+
+            if (strcmp("BEST", mode) == 0){
+                inst->options_t.twoopt = TWOOPT_BEST;
+            }else if (strcmp("FIRST", mode) == 0){
+                inst->options_t.twoopt = TWOOPT_FIRST;
+            }else{
+                log_warn("2opt move selection not recognized, using FIRST as default");
+            }
+
+            continue;
+        }
+
         if(strcmp("-q", argv[i]) == 0){
             err_setverbosity(QUIET);
             continue;
@@ -228,12 +964,33 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
         printf(COLOR_BOLD "Options:\n" COLOR_OFF);
         printf("    --help, -help, -h       prints this text\n");
         printf("    -file, -f <path>        input a TSPLIB file format\n");
+        printf("    -bin <path>             input a .tspbin cache written by -bin_out, mapped instead of parsed\n");
+        printf("    -bin_out <path>         writes points, candidate lists and packed or quantized costs to a .tspbin cache\n");
+        printf("    -init <path>            TSPLIB tour from which tabu search and VNS start, instead of their greedy warm-up\n");
+        printf("    -checkpoint <path>      TSPLIB tour to which tabu search and VNS save their best tour, resume with -init <path>\n");
+        printf("    -checkpoint_every <value> seconds between two checkpoints, default %d\n", DEFAULT_CHECKPOINT_INTERVAL);
         printf("    -time, -t <value>       execution time limit in seconds\n");
+        printf("    -parser <option>        reader of the input file: MMAP (default, numbers parsed in place, split among threads) or STDIO\n");
         printf("    -seed <value>           seed for random generation, if not set defaults to user time\n");
         printf("    -alg <option>           selects the algorithm to solve TSP, run --all_algs to see the options\n");
         printf("    -n <value>              number of nodes\n");
+        printf("    -costs <option>         storage of the costs: AUTO (default), MATRIX, PACKED, QUANT16, QUANT32, INT32 or ORACLE\n");
+        printf("    --integer               if present, costs are TSPLIB EUC_2D distances rounded to the nearest integer, INT32 implies it\n");
+        printf("    -mem <value>            memory budget in MB for the costs, AUTO picks MATRIX, PACKED or ORACLE to fit it\n");
+        printf("    -cache_rows <value>     rows cached by the ORACLE storage, 0 (default) disables the cache\n");
+        printf("    -threads <value>        number of worker threads, defaults to the available processors\n");
+        printf("    -cand <option>          candidate neighbors: KNN (default), QUADRANT, ALPHA or NONE\n");
+        printf("    -cand_k <value>         length of the candidate lists, default %d\n", DEFAULT_CANDIDATES);
+        printf("    -2opt <option>          2opt move selection of 2OPT_GREEDY, 2OPT and VNS: FIRST (default, queue with don't-look bits) or BEST\n");
+        printf("    -vns_ls <option>        local search of VNS: 2OPT (default), 3OPT or LK\n");
+        printf("    -vns_nbh <list>         ordered neighborhoods of VNS among 2OPT, OROPT, 3OPT and LK, e.g. 2OPT,OROPT,3OPT\n");
+        printf("    --vns_adaptive          if present, VNS picks the neighborhoods by recent improvement per CPU time\n");
         printf("    --all_algs              prints all possible algorithms\n");
         printf("    --to_file               if present, plots will be saved in directory /plots\n");
+        printf("    -tabu_policy <option>   tenure of tabu search: FIXED, SIZE, RANDOM, LINEAR (default) or REACTIVE\n");
+        printf("    -tabu_walkers <value>   parallel tabu search walkers, the others take the policies after the chosen one, default 1\n");
+        printf("    -tabu_restart <value>   iterations after which a walker behind the best tour restarts from it, 0 (default) never\n");
+        printf("    --oropt                 if present, local searches alternate 2opt and Or-opt moves\n");
         printf("    -q                      quiet verbosity level, prints only output\n");
         printf("    -v                      verbose verbosity level, prints info, warnings, errors or fatal errors\n");
         printf("    -vv                     verbose verbosity level, prints also debug and trace\n");
@@ -246,8 +1003,11 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
         printf("    - GREEDY\n");
         printf("    - GREEDY_ITER\n");
         printf("    - 2OPT_GREEDY\n");
-        printf("    - TABU_SEARCH");
-        printf("    - VNS");
+        printf("    - 2OPT\n");
+        printf("    - TABU_SEARCH\n");
+        printf("    - VNS\n");
+        printf("    - 3OPT\n");
+        printf("    - LK\n");
         
         return ABORTED;
     }
@@ -255,17 +1015,35 @@ ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst){
     return OK;
 }
 
+void tsp_set_timelimit(instance* inst, double seconds){
+    inst->options_t.timelimit = seconds;
+    deadline_set(&inst->deadline, seconds);
+}
+
+void tsp_set_seed(instance* inst, int seed){
+    inst->options_t.seed = seed;
+    rng_seed(&inst->rng, (uint64_t) seed);
+}
+
 ERROR_CODE tsp_generate_randompoints(instance* inst){
-    srand(inst->options_t.seed);
+    // points have their own stream, so the ones of the algorithms do not depend on the instance
+    rng_state rng;
+    rng_seed(&rng, (uint64_t) inst->options_t.seed);
 
     inst->points = (point*) calloc(inst->nnodes, sizeof(point));
+    inst->points_allocated = true;
 
     for(int i=0; i<inst->nnodes; i++){
-        inst->points[i].x = TSP_RAND();
-        inst->points[i].y = TSP_RAND();
+        inst->points[i].x = TSP_RAND(&rng);
+        inst->points[i].y = TSP_RAND(&rng);
     }
 
     tsp_compute_costs(inst);
+    tsp_compute_candidates(inst);
+
+    if(inst->options_t.binfile != NULL){
+        tsp_write_binary(inst);
+    }
 
     return OK;
 }
@@ -324,95 +1102,148 @@ void tsp_free_instance(instance *inst){
     if(inst->options_t.graph_input){
         free(inst->options_t.inputfile);
     }
+    free(inst->options_t.binfile);
+    free(inst->options_t.initfile);
+    free(inst->options_t.checkpointfile);
+
+    if(inst->candidates.type != CAND_NONE && !tspbin_contains(&inst->binary, inst->candidates.offsets)){
+        cand_free(&inst->candidates);
+    }
+
+    if(inst->tree_built){
+        kd_free(&inst->tree);
+    }
     if(inst->points_allocated){
         free(inst->points);
     }
 
     if(inst->costs_computed){
-        free(inst->costs);
+        if(inst->costs_mode == COSTS_MATRIX){
+            free(inst->costs);
+        }else if(tspbin_contains(&inst->binary, inst->packed_costs.f32)){
+            // mapped, released with the cache
+        }else if(inst->costs_mode == COSTS_PACKED){
+            free(inst->packed_costs.f32);
+        }else if(inst->costs_mode == COSTS_QUANT16){
+            free(inst->packed_costs.u16);
+        }else if(inst->costs_mode == COSTS_QUANT32){
+            free(inst->packed_costs.u32);
+        }else if(inst->costs_mode == COSTS_INT32){
+            free(inst->int_costs);
+        }
+
+        if(inst->cache.nrows > 0){
+            free(inst->cache.tags);
+            free(inst->cache.pending);
+            free(inst->cache.rows);
+        }
     }
+
+    tspbin_close(&inst->binary);
 }
 
-void tsp_read_input(instance* inst){
-    FILE *input_file = fopen(inst->options_t.inputfile, "r");
-	if ( input_file == NULL ){
-        log_fatal(" input file not found!");
+/**
+ * @brief Maps the .tspbin cache: points are copied out of the SoA coordinates, candidate lists
+ * and packed costs are used in place when they match the options; with -costs AUTO only the
+ * exact PACKED costs are, QUANT16 and QUANT32 ones need -costs to name them
+ */
+static void tsp_read_binary(instance* inst){
+    ERROR_CODE error = tspbin_open(&inst->binary, inst->options_t.inputfile);
+    if(error != OK){
+        log_fatal("cannot map %s, code error: %d", inst->options_t.inputfile, error);
         tsp_handlefatal(inst);
     }
 
-    inst->nnodes = -1;
+    tspbin* bin = &inst->binary;
+    inst->nnodes = bin->nnodes;
+    inst->points = (point*) malloc(inst->nnodes * sizeof(point));
+    if(inst->points == NULL){
+        log_fatal("cannot allocate points");
+        tsp_handlefatal(inst);
+    }
+    inst->points_allocated = true;
+    for(int i=0; i<inst->nnodes; i++){
+        inst->points[i].x = bin->xs[i];
+        inst->points[i].y = bin->ys[i];
+    }
 
-    char line[300];
-	char *token2, *token1, *parameter;
+    if(bin->candidates.type != CAND_NONE && bin->candidates.type == inst->options_t.candidates && bin->candidates.k == inst->options_t.candidates_k){
+        log_debug("using the cached candidate lists");
+        inst->candidates = bin->candidates;
+    }
 
-    int node_section = 0;
+    cost_mode mode = COSTS_AUTO;
+    switch(bin->costs_type){
+        case TSPBIN_COSTS_F32: mode = COSTS_PACKED; break;
+        case TSPBIN_COSTS_U16: mode = COSTS_QUANT16; break;
+        case TSPBIN_COSTS_U32: mode = COSTS_QUANT32; break;
+        default: break;
+    }
+    if(mode != COSTS_AUTO && bin->costs_nint != inst->options_t.integer_costs){
+        log_info("cached costs were computed with the other rounding, computing them again");
+        mode = COSTS_AUTO;
+    }
+    // quantized costs are approximate, they replace the exact ones only when -costs asks for them
+    bool requested = inst->options_t.costs_mode == mode || (inst->options_t.costs_mode == COSTS_AUTO && mode == COSTS_PACKED);
+    if(mode != COSTS_AUTO && !requested){
+        log_info("cached costs in mode %d do not match -costs, computing them again", mode);
+    }
+    if(mode != COSTS_AUTO && requested){
+        log_info("using the cached costs in mode %d", mode);
+        inst->costs_mode = mode;
+        inst->packed_costs.f32 = (float*) bin->costs;
+        inst->costs_scale = bin->costs_scale;
+        inst->cache.nrows = 0;
+        inst->costs_computed = true;
+    }
+}
 
-    while ( fgets(line, sizeof(line), input_file) != NULL ) {
-        if ( strlen(line) <= 1 ) continue; // skip empty lines
-	    parameter = strtok(line, " :");
+void tsp_read_input(instance* inst){
+    ERROR_CODE error;
+    if(inst->options_t.bin_input){
+        tsp_read_binary(inst);
+    }else{
+        error = tsplib_read(inst->options_t.inputfile, inst->options_t.parser, inst->options_t.threads, &inst->nnodes, &inst->points);
+        if(error != OK){
+            log_fatal("cannot read %s, code error: %d", inst->options_t.inputfile, error);
+            tsp_handlefatal(inst);
+        }
+        inst->points_allocated = true;
+    }
 
-        if ( strncmp(parameter, "DIMENSION", 9) == 0 ) {
-			if ( inst->nnodes >= 0 ) {
-                log_fatal("two DIMENSION parameters in the file");
-                tsp_handlefatal(inst);
-            }
-			token1 = strtok(NULL, " :");
-			inst->nnodes = atoi(token1);	 
-			inst->points = (point *) calloc(inst->nnodes, sizeof(point));
-            inst->points_allocated = true;
-			continue;
-		}
-
-        if ( strncmp(parameter, "NODE_COORD_SECTION", 18) == 0 ) 
-		{
-			if ( inst->nnodes <= 0 ){
-                log_fatal("DIMENSION not found");
-                tsp_handlefatal(inst);
-            } 
-			node_section = 1;   
-			continue;
-		}
-
-        if ( strncmp(parameter, "TYPE", 4) == 0 ) 
-		{
-			token1 = strtok(NULL, " :");  
-			if ( strncmp(token1, "TSP",3) != 0 ){
-                log_fatal(" format error:  only TSP file type accepted");
-                tsp_handlefatal(inst);
-            } 
-			continue;
-		}
-
-        if ( strncmp(parameter, "EDGE_WEIGHT_TYPE", 16) == 0 ) 
-		{
-			token1 = strtok(NULL, " :");
-			if ( strncmp(token1, "EUC_2D", 6) != 0 ){
-                log_fatal(" format error:  only EDGE_WEIGHT_TYPE == EUC_2D managed");
-                tsp_handlefatal(inst);
-            }
-			continue;
-		}
+    if(!inst->costs_computed){
+        error = tsp_compute_costs(inst);
+        if(!err_ok(error)){
+            log_error("code error: %d", error);
+        }
+    }
 
-        if ( strncmp(parameter, "EOF", 3) == 0 ) {
-			break;
-		}
+    if(inst->candidates.type == CAND_NONE){
+        error = tsp_compute_candidates(inst);
+        if(!err_ok(error)){
+            log_error("code error: %d", error);
+        }
+    }
 
-        if (node_section) {
-			int i = atoi(parameter) - 1; //index 
-			token1 = strtok(NULL, " :,");
-			token2 = strtok(NULL, " :,");
-            point new_point;
-            new_point.x = atof(token1);
-            new_point.y = atof(token2);
-			inst->points[i] = new_point;
-			continue;
-		}
+    if(inst->options_t.binfile != NULL){
+        tsp_write_binary(inst);
     }
+}
 
-    ERROR_CODE error = tsp_compute_costs(inst);
-    if(!err_ok(error)){
-        log_error("code error: %d", error);
+ERROR_CODE tsp_write_binary(instance* inst){
+    tspbin_costs type = TSPBIN_COSTS_NONE;
+    if(inst->costs_computed && !deadline_stopped(&inst->deadline)){
+        switch(inst->costs_mode){
+            case COSTS_PACKED:  type = TSPBIN_COSTS_F32; break;
+            case COSTS_QUANT16: type = TSPBIN_COSTS_U16; break;
+            case COSTS_QUANT32: type = TSPBIN_COSTS_U32; break;
+            default:
+                log_info("costs in mode %d are not cached, only PACKED, QUANT16 and QUANT32 are", inst->costs_mode);
+                break;
+        }
     }
+
+    return tspbin_write(inst->options_t.binfile, inst->points, inst->nnodes, &inst->candidates, type, inst->options_t.integer_costs, inst->costs_scale, type == TSPBIN_COSTS_NONE ? NULL : (const void*) inst->packed_costs.f32);
 }
 
 ERROR_CODE tsp_compute_costs(instance* inst){
@@ -423,43 +1254,167 @@ ERROR_CODE tsp_compute_costs(instance* inst){
         tsp_handlefatal(inst);
     }
 
-    inst->costs = (double *) calloc(inst->nnodes * inst->nnodes, sizeof(double));
+    inst->costs_mode = tsp_select_costs_mode(inst);
+
+    if(inst->costs_mode == COSTS_ORACLE){
+        log_info("cost matrix does not fit in memory budget, computing costs on demand");
+        costs_init_cache(inst);
+        inst->costs_computed = true;
+        return OK;
+    }
+
+    log_info("storing costs in mode %d, %.1f MB", inst->costs_mode, tsp_costs_size(inst->nnodes, inst->costs_mode));
+
+    ERROR_CODE e = costs_alloc(inst);
+    if(!err_ok(e)){
+        log_fatal("code %d : cannot allocate costs", e);
+        tsp_handlefatal(inst);
+    }
+    inst->costs_computed = true;
+
+    costs_job job;
+    job.inst = inst;
+    job.nblocks = (inst->nnodes + COSTS_TILE - 1) / COSTS_TILE;
+    job.next_block = 0;
+    job.xs = (double*) malloc(inst->nnodes * sizeof(double));
+    job.ys = (double*) malloc(inst->nnodes * sizeof(double));
+    if(job.xs == NULL || job.ys == NULL){
+        free(job.xs);
+        free(job.ys);
+        log_fatal("cannot allocate coordinates for the costs computation");
+        tsp_handlefatal(inst);
+    }
+
+    for(int i=0; i<inst->nnodes; i++){
+        job.xs[i] = inst->points[i].x;
+        job.ys[i] = inst->points[i].y;
+    }
+
+    int nthreads = inst->options_t.threads < job.nblocks ? inst->options_t.threads : job.nblocks;
+    log_debug("computing costs with %d threads, simd level %d", nthreads, simd_detect());
+
+    threads_run(nthreads, costs_touch_task, &job);
+    threads_run(nthreads, costs_tile_task, &job);
+
+    free(job.xs);
+    free(job.ys);
+
+    return deadline_stopped(&inst->deadline) ? DEADLINE_EXCEEDED : OK;
+}
+
+ERROR_CODE tsp_compute_candidates(instance* inst){
+    if(inst->candidates.type != CAND_NONE){
+        return ALREADY_EXISTS;
+    }
+
+    log_debug("computing candidate lists");
+
+    ERROR_CODE e = cand_build(&inst->candidates, inst->points, inst->nnodes, inst->options_t.candidates, inst->options_t.candidates_k, inst->options_t.threads);
+    if(!err_ok(e)){
+        log_warn("code %d : cannot build candidate lists, local search will scan all nodes", e);
+        inst->candidates.type = CAND_NONE;
+    }
 
-    for (int i = 0; i < inst->nnodes; i++) {
-        // Initialize each element of the matrix to -1 -> infinite cost
-        for (int j = 0; j < inst->nnodes; j++) {
-            inst->costs[i* inst->nnodes + j] = -1.0f;
+    return e;
+}
+
+kdtree* tsp_points_tree(instance* inst){
+    if(!inst->tree_built){
+        log_debug("building k-d tree");
+        if(!err_ok(kd_build(&inst->tree, inst->points, inst->nnodes))){
+            log_error("cannot build k-d tree");
+            return NULL;
         }
+        inst->tree_built = true;
     }
 
-    // computation of costs of edges with euclidean distance
-    for (int i = 0; i < inst->nnodes; i++) {
-        for (int j = 0; j < inst->nnodes; j++) {
+    return &inst->tree;
+}
 
-            // check that we have not exceed time limit
-            double ex_time = utils_timeelapsed(inst->c);
-            if(inst->options_t.timelimit != -1.0){
-                if(ex_time > inst->options_t.timelimit){
-                    return DEADLINE_EXCEEDED;
-                }
-            }
+cost_mode tsp_select_costs_mode(instance* inst){
+    if(inst->options_t.costs_mode != COSTS_AUTO){
+        return inst->options_t.costs_mode;
+    }
 
-            if (j == i){
-                continue;
-            }
-            double distance = sqrtf(pow(inst->points[j].x - inst->points[i].x, 2) + pow(inst->points[j].y - inst->points[i].y, 2));
-            inst->costs[i* inst->nnodes + j] = distance;
-            inst->costs[j* inst->nnodes + i] = distance;
+    // integer costs fit in half the bytes of the dense matrix
+    const cost_mode lossless[] = {COSTS_MATRIX, COSTS_PACKED};
+    const cost_mode lossless_integer[] = {COSTS_INT32};
+    const cost_mode* modes = inst->options_t.integer_costs ? lossless_integer : lossless;
+    size_t nmodes = inst->options_t.integer_costs ? 1 : 2;
+    for(size_t m=0; m<nmodes; m++){
+        double mb = tsp_costs_size(inst->nnodes, modes[m]);
+        log_debug("costs in mode %d need %.1f MB, budget is %d MB", modes[m], mb, inst->options_t.memory_budget);
+        if(mb <= inst->options_t.memory_budget){
+            return modes[m];
         }
     }
 
-    inst->costs_computed = true;
+    return COSTS_ORACLE;
+}
 
-    return OK;
+double tsp_costs_size(int nnodes, cost_mode mode){
+    double n = nnodes;
+    double npairs = n * (n - 1) / 2;
+    double bytes;
+
+    switch(mode){
+        case COSTS_MATRIX:  bytes = n * n * sizeof(double); break;
+        case COSTS_PACKED:  bytes = npairs * sizeof(float); break;
+        case COSTS_QUANT16: bytes = npairs * sizeof(uint16_t); break;
+        case COSTS_QUANT32: bytes = npairs * sizeof(uint32_t); break;
+        case COSTS_INT32:   bytes = n * n * sizeof(int32_t); break;
+        default:            bytes = 0; break;
+    }
+
+    return bytes / (1024.0 * 1024.0);
 }
 
 double tsp_get_cost(instance* inst, int i, int j){
-    return inst->costs[i * inst->nnodes + j];
+    switch(inst->costs_mode){
+        case COSTS_MATRIX:
+            return inst->costs[(size_t)i * inst->nnodes + j];
+        case COSTS_ORACLE:
+            return costs_oracle(inst, i, j);
+        case COSTS_INT32:
+            return tsp_get_int_cost(inst, i, j);
+        default:
+            break;
+    }
+
+    if(i == j){
+        return NOT_CONNECTED;
+    }
+
+    size_t idx = costs_packed_index(inst->nnodes, i, j);
+    switch(inst->costs_mode){
+        case COSTS_PACKED:
+            return inst->packed_costs.f32[idx];
+        case COSTS_QUANT16:
+            return inst->packed_costs.u16[idx] * inst->costs_scale;
+        case COSTS_QUANT32:
+            return inst->packed_costs.u32[idx] * inst->costs_scale;
+        default:
+            return NOT_CONNECTED;
+    }
+}
+
+int tsp_costs_threads(instance* inst){
+    if(inst->costs_mode == COSTS_ORACLE && inst->cache.nrows > 0){
+        return 1;
+    }
+
+    return inst->options_t.threads;
+}
+
+double tsp_tour_length(instance* inst, const int* successors){
+    double length = 0;
+    for(int i=0; i<inst->nnodes; i++){
+        double dx = inst->points[successors[i]].x - inst->points[i].x;
+        double dy = inst->points[successors[i]].y - inst->points[i].y;
+        length += inst->options_t.integer_costs ? costs_nint(dx, dy) : sqrt(dx * dx + dy * dy);
+    }
+
+    return length;
 }
 
 bool tsp_validate_solution(instance* inst, int* current_solution_path) {
@@ -505,3 +1460,88 @@ ERROR_CODE tsp_update_best_solution(instance* inst, tsp_solution* current_soluti
         return INVALID_ARGUMENT;
     }   
 }
+
+ERROR_CODE tsp_read_tour(instance* inst, const char* path){
+    int* order = (int*) malloc(inst->nnodes * sizeof(int));
+    tsp_solution solution = tsp_init_solution(inst->nnodes);
+    if(order == NULL || solution.path == NULL){
+        free(order);
+        free(solution.path);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    ERROR_CODE e = tsplib_read_tour(path, inst->nnodes, order);
+    if(e == OK){
+        solution.cost = 0;
+        for(int i=0; i<inst->nnodes; i++){
+            int next = order[(i + 1) % inst->nnodes];
+            solution.path[order[i]] = next;
+            solution.cost += tsp_get_cost(inst, order[i], next);
+        }
+        log_info("read tour %s, cost %f", path, solution.cost);
+        e = tsp_update_best_solution(inst, &solution);
+    }
+
+    free(order);
+    free(solution.path);
+
+    return e;
+}
+
+ERROR_CODE tsp_write_tour(instance* inst, const char* path, const int* successors, double cost){
+    int* order = (int*) malloc(inst->nnodes * sizeof(int));
+    if(order == NULL){
+        return RESOURCE_EXHAUSTED;
+    }
+
+    order[0] = 0;
+    for(int i=1; i<inst->nnodes; i++){
+        order[i] = successors[order[i - 1]];
+    }
+
+    const char* name = strrchr(inst->options_t.inputfile, '/');
+    name = name == NULL ? inst->options_t.inputfile : name + 1;
+    ERROR_CODE e = tsplib_write_tour(path, name, inst->nnodes, order, cost);
+
+    free(order);
+
+    return e;
+}
+
+ERROR_CODE tsp_warm_start(instance* inst){
+    if(inst->options_t.initfile == NULL){
+        return NOT_FOUND;
+    }
+
+    ERROR_CODE e = tsp_read_tour(inst, inst->options_t.initfile);
+    if(e != OK){
+        log_warn("code %d : cannot start from the tour %s", e, inst->options_t.initfile);
+        return e;
+    }
+
+    // the seed is already on disk, a checkpoint is due only for a better tour
+    inst->checkpoint_cost = inst->best_solution.cost;
+    inst->checkpoint_time = deadline_elapsed(&inst->deadline);
+
+    return OK;
+}
+
+bool tsp_checkpoint_due(instance* inst, double cost){
+    return inst->options_t.checkpointfile != NULL && cost < inst->checkpoint_cost &&
+        deadline_elapsed(&inst->deadline) - inst->checkpoint_time >= inst->options_t.checkpoint_interval;
+}
+
+ERROR_CODE tsp_checkpoint(instance* inst, const int* successors, double cost){
+    if(inst->options_t.checkpointfile == NULL || cost >= inst->checkpoint_cost){
+        return CANCELLED;
+    }
+
+    ERROR_CODE e = tsp_write_tour(inst, inst->options_t.checkpointfile, successors, cost);
+    inst->checkpoint_time = deadline_elapsed(&inst->deadline);
+    if(e == OK){
+        inst->checkpoint_cost = cost;
+        log_info("checkpoint of cost %f saved to %s", cost, inst->options_t.checkpointfile);
+    }
+
+    return e;
+}
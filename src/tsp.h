@@ -12,20 +12,84 @@
  * 
  */
 #include "utils/plot.h"
+#include "utils/candidates.h"
+#include "utils/rng.h"
+#include "utils/deadline.h"
+#include "utils/simd.h"
+#include "utils/threads.h"
+#include "utils/tour.h"
+#include "utils/tsplib.h"
+#include "utils/tspbin.h"
 #include <libgen.h>
 #include <math.h>
+#include <stdint.h>
 
 #define EPSILON -1.0E-7
 
+#define DEFAULT_MEMORY_BUDGET 2048     // MB allowed for the precomputed cost matrix
+#define DEFAULT_CHECKPOINT_INTERVAL 60  // seconds between two checkpoints of the best tour
+#define COSTS_TILE 64                   // side of the tiles in which costs are computed
+
 typedef enum {
     ALG_GREEDY = 0,
     ALG_GREEDY_ITER = 1,
     ALG_2OPT_GREEDY = 2,
     ALG_TABU_SEARCH = 3,
     ALG_VNS = 4,
-    ALG_CPLEX = 5
+    ALG_CPLEX = 5,
+    ALG_3OPT = 6,
+    ALG_LK = 7,
+    ALG_2OPT = 8
 } algorithms;
 
+/**
+ * @brief Storage of the edge costs
+ * 
+ */
+typedef enum {
+    COSTS_AUTO = 0,             // first lossless storage that fits in the memory budget
+    COSTS_MATRIX = 1,           // dense nnodes x nnodes matrix
+    COSTS_ORACLE = 2,           // distances computed on demand from the points
+    COSTS_PACKED = 3,           // float32 upper triangle, lossless since distances come from sqrtf
+    COSTS_QUANT16 = 4,          // uint16 upper triangle times costs_scale
+    COSTS_QUANT32 = 5,          // uint32 upper triangle times costs_scale
+    COSTS_INT32 = 6             // dense nnodes x nnodes int32 matrix, only with integer costs
+} cost_mode;
+
+/**
+ * @brief Move selection of the 2opt local search
+ * 
+ */
+typedef enum {
+    TWOOPT_BEST = 0,            // full O(n^2) scan, applies the best move
+    TWOOPT_FIRST = 1            // active queue with don't-look bits, applies the first improving move
+} twoopt_mode;
+
+#define VNS_MAX_NEIGHBORHOODS 4  // neighborhoods of the descent of VNS, one per local search
+
+/**
+ * @brief Local searches, used as neighborhoods by the descent of VNS
+ * 
+ */
+typedef enum {
+    LS_2OPT = 0,
+    LS_3OPT = 1,
+    LS_LK = 2,
+    LS_OROPT = 3
+} local_search;
+
+/**
+ * @brief Policies for Tabu Search
+ * 
+ */
+typedef enum{
+    POL_FIXED = 0,
+    POL_SIZE = 1,
+    POL_RANDOM = 2,
+    POL_LINEAR = 3,
+    POL_REACTIVE = 4            // tenure driven by revisited tours, with escapes from cycles
+} POLICIES;
+
 typedef struct {
     double timelimit;           // time limit of the algorithm (in seconds)
     int seed;                   // seed for random generation, if not set by the user, defaults to current time
@@ -34,8 +98,43 @@ typedef struct {
     char* inputfile;            // input file path
     bool tofile;                // if true, plots will be saved in directory /plots
     int k;
+    cost_mode costs_mode;       // requested storage of the costs
+    bool integer_costs;         // if true, costs are TSPLIB EUC_2D distances, rounded to the nearest integer
+    int memory_budget;          // memory budget in MB for the cost matrix
+    int cache_rows;             // rows kept by the distance oracle cache, 0 disables it
+    int threads;                // number of worker threads
+    candidate_type candidates;  // how candidate neighbors are chosen
+    int candidates_k;           // length of the candidate lists
+    twoopt_mode twoopt;         // move selection of the 2opt local search
+    bool oropt;                 // if true, local searches alternate 2opt and Or-opt until neither improves
+    local_search vns_ls;        // local search of VNS
+    local_search vns_neighborhoods[VNS_MAX_NEIGHBORHOODS]; // ordered neighborhoods of the descent of VNS
+    int vns_count;              // neighborhoods set with -vns_nbh, 0 for vns_ls followed by Or-opt if oropt is set
+    bool vns_adaptive;          // if true the descent picks neighborhoods by recent improvement per CPU ms, else in order
+    POLICIES tabu_policy;       // tenure policy of tabu search
+    int tabu_walkers;           // tabu search walkers, each on its own thread
+    int tabu_restart;           // iterations between restarts of the walkers from the best tour, 0 disables them
+    tsplib_parser parser;       // reader of the input file
+    bool bin_input;             // if true, inputfile is a .tspbin cache instead of a TSPLIB file
+    char* binfile;              // .tspbin cache written once the instance is built, NULL for none
+    char* initfile;             // TSPLIB tour that seeds the best solution of the metaheuristics, NULL for none
+    char* checkpointfile;       // TSPLIB tour to which the metaheuristics save their best solution, NULL for none
+    double checkpoint_interval; // seconds between two checkpoints
 } options;
 
+/**
+ * @brief Bounded cache of cost rows for the distance oracle.
+ * Rows are direct-mapped on slot i % nrows and a row is filled only when it is
+ * requested twice in a row, so scattered lookups never pay an O(n) refill
+ * 
+ */
+typedef struct {
+    int nrows;                  // number of slots
+    int* tags;                  // node whose row is stored in each slot, -1 if empty
+    int* pending;               // last node that missed on each slot
+    double* rows;               // nrows x nnodes cached distances
+} cost_cache;
+
 typedef struct {
     double cost;
     int* path;
@@ -48,17 +147,38 @@ typedef struct {
 
     int nnodes;                 // number of nodes
 
-    struct utils_clock c;       // clock
+    deadline deadline;          // wall-clock time limit of the run, polled by every algorithm
     
     bool points_allocated;
     point* points;              // dynamic array of points
 
     bool costs_computed;        
+    cost_mode costs_mode;       // storage actually in use, never COSTS_AUTO
     double* costs;             // matrix of costs between pairs of points
+    int32_t* int_costs;         // matrix of integer costs for COSTS_INT32
+    cost_cache cache;           // row cache for COSTS_ORACLE
+    union {
+        float* f32;
+        uint16_t* u16;
+        uint32_t* u32;
+    } packed_costs;             // upper triangle without diagonal for the packed storages
+    double costs_scale;         // length of one quantization step
+
+    candidate_list candidates;  // neighbor lists to restrict local search moves
+
+    bool tree_built;
+    kdtree tree;                // k-d tree over the points, built on first use
 
     tsp_solution best_solution;
 
     int starting_node;          // save the starting node of the best tour
+
+    rng_state rng;              // random stream of the main thread, workers take streams jumped from it
+
+    tspbin binary;              // cache the instance was loaded from, its candidate lists and costs are used in place
+
+    double checkpoint_time;     // elapsed seconds at the last checkpoint
+    double checkpoint_cost;     // cost of the tour saved by the last checkpoint
 } instance;
 
 /**
@@ -85,6 +205,22 @@ tsp_solution tsp_init_solution(int nnodes);
  */
 ERROR_CODE tsp_parse_commandline(int argc, char** argv, instance* inst);
 
+/**
+ * @brief Sets the seed and restarts the random stream of the instance from it
+ * 
+ * @param inst 
+ * @param seed 
+ */
+void tsp_set_seed(instance* inst, int seed);
+
+/**
+ * @brief Sets the time limit of the run, counted from tsp_init
+ * 
+ * @param inst 
+ * @param seconds negative for no limit
+ */
+void tsp_set_timelimit(instance* inst, double seconds);
+
 /**
  * @brief Generate random points with given seed and number of nodes
  * 
@@ -123,19 +259,46 @@ void tsp_free_instance(instance *inst);
 void tsp_handlefatal(instance *inst);
 
 /**
- * @brief Reads a TSPLIB formatted input file
+ * @brief Reads a TSPLIB formatted input file, or maps a .tspbin cache if options_t.bin_input is set,
+ * and writes the cache to options_t.binfile if set
  * 
  * @param inst, pointer to an instance
  */
 void tsp_read_input(instance* inst);
 
 /**
- * @brief Precomputes costs and keeps them in matrix costs of the instance
+ * @brief Precomputes costs and keeps them in the storage selected by tsp_select_costs_mode.
+ * With COSTS_ORACLE only the oracle cache is allocated and costs are computed on demand
  * 
  * @param inst 
  */
 ERROR_CODE tsp_compute_costs(instance* inst);
 
+/**
+ * @brief Builds the candidate neighbor lists selected in the options, once per instance
+ * 
+ * @param inst 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tsp_compute_candidates(instance* inst);
+
+/**
+ * @brief Writes points, candidate lists and, for the packed storages, costs to the .tspbin cache
+ * options_t.binfile. Costs cut short by the time limit are left out
+ * 
+ * @param inst 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tsp_write_binary(instance* inst);
+
+/**
+ * @brief k-d tree over the points of the instance, built on the first call
+ * 
+ * @param inst 
+ * @return kdtree* NULL if it cannot be built
+ */
+kdtree* tsp_points_tree(instance* inst);
+
 /**
  * @brief Validates a tsp solution
  * 
@@ -145,6 +308,16 @@ ERROR_CODE tsp_compute_costs(instance* inst);
  */
 bool tsp_validate_solution(instance* inst, int* current_solution_path);
 
+/**
+ * @brief Length of a tour recomputed from the points in double precision, or with the TSPLIB
+ * rounding with integer costs. Unlike the solution cost, it does not depend on the cost storage
+ * 
+ * @param inst 
+ * @param successors tour as successor array
+ * @return double 
+ */
+double tsp_tour_length(instance* inst, const int* successors);
+
 /**
  * @brief Updates the best solution iff it is valid and it is better than the current best solution
  * 
@@ -152,6 +325,86 @@ bool tsp_validate_solution(instance* inst, int* current_solution_path);
  */
 ERROR_CODE tsp_update_best_solution(instance* inst, tsp_solution* solution);
 
+/**
+ * @brief Reads a TSPLIB tour and makes it the best solution if it is better
+ * 
+ * @param inst 
+ * @param path tour file
+ * @return ERROR_CODE OK if the tour is the new best solution
+ */
+ERROR_CODE tsp_read_tour(instance* inst, const char* path);
+
+/**
+ * @brief Writes a tour in the TSPLIB format
+ * 
+ * @param inst 
+ * @param path tour file
+ * @param successors tour as successor array
+ * @param cost cost of the tour
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tsp_write_tour(instance* inst, const char* path, const int* successors, double cost);
+
+/**
+ * @brief Warm start of the metaheuristics: the best solution is seeded with the tour of options_t.initfile,
+ * e.g. the checkpoint of a previous run
+ * 
+ * @param inst 
+ * @return ERROR_CODE OK if the best solution was seeded, NOT_FOUND without options_t.initfile
+ */
+ERROR_CODE tsp_warm_start(instance* inst);
+
+/**
+ * @brief Util to check if a tour of the given cost should be checkpointed: options_t.checkpointfile is set,
+ * the tour is better than the saved one and options_t.checkpoint_interval seconds have passed
+ * 
+ * @param inst 
+ * @param cost cost of the best tour
+ * @return true if tsp_checkpoint should be called
+ */
+bool tsp_checkpoint_due(instance* inst, double cost);
+
+/**
+ * @brief Saves the tour to options_t.checkpointfile if it is better than the saved one
+ * 
+ * @param inst 
+ * @param successors tour as successor array
+ * @param cost cost of the tour
+ * @return ERROR_CODE CANCELLED if nothing was saved
+ */
+ERROR_CODE tsp_checkpoint(instance* inst, const int* successors, double cost);
+
+/**
+ * @brief Selects the cost storage for the instance. COSTS_AUTO resolves to the first of
+ * COSTS_MATRIX, COSTS_PACKED and COSTS_ORACLE that fits in the memory budget, or of COSTS_INT32
+ * and COSTS_ORACLE with integer costs; quantized storages are lossy and only used when requested
+ * 
+ * @param inst 
+ * @return cost_mode storage to use, never COSTS_AUTO
+ */
+cost_mode tsp_select_costs_mode(instance* inst);
+
+/**
+ * @brief Memory needed by a cost storage
+ * 
+ * @param nnodes number of nodes
+ * @param mode cost storage
+ * @return double size in MB
+ */
+double tsp_costs_size(int nnodes, cost_mode mode);
+
+/**
+ * @brief Cost of edge i-j for COSTS_INT32, without the dispatch of tsp_get_cost
+ * 
+ * @param inst tsp instance
+ * @param i node i
+ * @param j node j
+ * @return int32_t cost of edge i-j, -1 if i == j
+ */
+static inline int32_t tsp_get_int_cost(const instance* inst, int i, int j){
+    return inst->int_costs[(size_t)i * inst->nnodes + j];
+}
+
 /**
  * @brief Get cost of edge i-j, returns -1 if it does not exist
  * 
@@ -162,6 +415,15 @@ ERROR_CODE tsp_update_best_solution(instance* inst, tsp_solution* solution);
  */
 double tsp_get_cost(instance* inst, int i, int j);
 
+/**
+ * @brief Number of threads that can call tsp_get_cost concurrently: options_t.threads,
+ * or 1 when the distance oracle fills its row cache in place
+ * 
+ * @param inst tsp instance
+ * @return int 
+ */
+int tsp_costs_threads(instance* inst);
+
 tsp_solution tsp_init_solution(int nnodes);
 
 #endif
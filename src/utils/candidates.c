@@ -0,0 +1,545 @@
+#include "candidates.h"
+#include "threads.h"
+
+#include <math.h>
+
+/**
+ * @brief Shared state of the workers querying the k-d tree
+ */
+typedef struct {
+    const kdtree* tree;
+    const point* points;
+    int nnodes;
+    candidate_type type;        // CAND_KNN or CAND_QUADRANT
+    int width;                  // neighbors collected per node
+    int* lists;                 // nnodes x width neighbors
+    int* counts;                // neighbors found per node
+    ERROR_CODE e;               // RESOURCE_EXHAUSTED if a worker cannot allocate its scratch
+} cand_job;
+
+/**
+ * @brief Tree of the 1-tree with binary lifting tables for path maximum queries
+ */
+typedef struct {
+    int nnodes;
+    int levels;
+    int* component;             // root of the tree containing each node
+    int* depth;
+    int* up;                    // levels x nnodes ancestors
+    float* max_edge;            // levels x nnodes maximum edge towards the ancestor
+} cand_tree;
+
+static void cand_free_tree(cand_tree* t);
+
+typedef struct {
+    float w;
+    int u;
+    int v;
+} cand_edge;
+
+/**
+ * @brief Same rounding as the cost matrix
+ */
+static inline double cand_distance(const point* points, int i, int j){
+    double dx = points[j].x - points[i].x;
+    double dy = points[j].y - points[i].y;
+    return sqrtf(dx * dx + dy * dy);
+}
+
+static inline double cand_sqdistance(const point* points, int i, int j){
+    double dx = points[j].x - points[i].x;
+    double dy = points[j].y - points[i].y;
+    return dx * dx + dy * dy;
+}
+
+/**
+ * @brief Sorts the list of node i by distance, ties broken by index
+ */
+static void cand_sort_by_distance(const point* points, int i, int* list, int count){
+    for(int c=1; c<count; c++){
+        int v = list[c];
+        double d = cand_sqdistance(points, i, v);
+        int j = c - 1;
+        while(j >= 0){
+            double dj = cand_sqdistance(points, i, list[j]);
+            if(dj < d || (dj == d && list[j] < v)) break;
+            list[j + 1] = list[j];
+            j--;
+        }
+        list[j + 1] = v;
+    }
+}
+
+//================================================================================
+// NEAREST AND QUADRANT NEIGHBORS
+//================================================================================
+
+/**
+ * @brief Up to width/4 nearest nodes per quadrant of node i, filled up with the nearest ones
+ * 
+ * @param nearest scratch of width nodes of the worker
+ */
+static int cand_quadrant_neighbors(const cand_job* job, int i, int* out, int* nearest){
+    const point* p = &job->points[i];
+    int width = job->width;
+    int per_quadrant = width / 4 > 0 ? width / 4 : 1;
+    int count = 0;
+
+    for(int q=0; q<4 && count<width; q++){
+        int want = per_quadrant < width - count ? per_quadrant : width - count;
+        count += kd_knn(job->tree, p->x, p->y, want, i, q, out + count, NULL);
+    }
+
+    // fill the remaining slots with the nearest nodes not already taken
+    if(count < width){
+        int found = kd_knn(job->tree, p->x, p->y, width, i, KD_ANY_QUADRANT, nearest, NULL);
+        for(int c=0; c<found && count<width; c++){
+            bool taken = false;
+            for(int t=0; t<count; t++){
+                if(out[t] == nearest[c]){
+                    taken = true;
+                    break;
+                }
+            }
+            if(!taken){
+                out[count++] = nearest[c];
+            }
+        }
+    }
+
+    cand_sort_by_distance(job->points, i, out, count);
+
+    return count;
+}
+
+static void cand_query_task(void* ctx, int thread_id, int nthreads){
+    cand_job* job = (cand_job*) ctx;
+
+    int* nearest = NULL;
+    if(job->type == CAND_QUADRANT){
+        nearest = (int*) malloc(job->width * sizeof(int));
+        if(nearest == NULL){
+            __atomic_store_n(&job->e, RESOURCE_EXHAUSTED, __ATOMIC_RELAXED);
+            return;
+        }
+    }
+
+    for(int i=thread_id; i<job->nnodes; i+=nthreads){
+        int* out = job->lists + (size_t)i * job->width;
+        if(job->type == CAND_QUADRANT){
+            job->counts[i] = cand_quadrant_neighbors(job, i, out, nearest);
+        }else{
+            const point* p = &job->points[i];
+            job->counts[i] = kd_knn(job->tree, p->x, p->y, job->width, i, KD_ANY_QUADRANT, out, NULL);
+        }
+    }
+
+    free(nearest);
+}
+
+//================================================================================
+// ALPHA-NEARNESS
+//================================================================================
+
+static int cand_edge_compare(const void* a, const void* b){
+    const cand_edge* ea = (const cand_edge*) a;
+    const cand_edge* eb = (const cand_edge*) b;
+    if(ea->w != eb->w) return ea->w < eb->w ? -1 : 1;
+    if(ea->u != eb->u) return ea->u - eb->u;
+    return ea->v - eb->v;
+}
+
+static int cand_find(int* parent, int x){
+    while(parent[x] != x){
+        parent[x] = parent[parent[x]];
+        x = parent[x];
+    }
+    return x;
+}
+
+/**
+ * @brief Minimum spanning forest of the sparse candidate graph without node 0, which is the
+ * special node of the 1-tree, rooted and prepared for path maximum queries
+ */
+static ERROR_CODE cand_build_tree(cand_tree* t, const point* points, int nnodes, const int* lists, const int* counts, int width){
+    size_t nedges = 0;
+    cand_edge* edges = (cand_edge*) malloc((size_t)nnodes * width * sizeof(cand_edge));
+    int* parent = (int*) malloc(nnodes * sizeof(int));
+    int* size = (int*) malloc(nnodes * sizeof(int));
+    int* adj_count = (int*) calloc(nnodes + 1, sizeof(int));
+    int* tree_u = (int*) malloc(nnodes * sizeof(int));
+    int* tree_v = (int*) malloc(nnodes * sizeof(int));
+    float* tree_w = (float*) malloc(nnodes * sizeof(float));
+
+    t->nnodes = nnodes;
+    t->levels = 1;
+    while((1 << t->levels) < nnodes) t->levels++;
+    t->component = (int*) malloc(nnodes * sizeof(int));
+    t->depth = (int*) malloc(nnodes * sizeof(int));
+    t->up = (int*) malloc((size_t)t->levels * nnodes * sizeof(int));
+    t->max_edge = (float*) malloc((size_t)t->levels * nnodes * sizeof(float));
+
+    if(edges == NULL || parent == NULL || size == NULL || adj_count == NULL || tree_u == NULL || tree_v == NULL || tree_w == NULL ||
+       t->component == NULL || t->depth == NULL || t->up == NULL || t->max_edge == NULL){
+        free(edges); free(parent); free(size); free(adj_count); free(tree_u); free(tree_v); free(tree_w);
+        cand_free_tree(t);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    for(int i=1; i<nnodes; i++){
+        for(int c=0; c<counts[i]; c++){
+            int j = lists[(size_t)i * width + c];
+            if(j == 0){
+                continue;
+            }
+            edges[nedges].w = (float) cand_distance(points, i, j);
+            edges[nedges].u = i < j ? i : j;
+            edges[nedges].v = i < j ? j : i;
+            nedges++;
+        }
+    }
+    qsort(edges, nedges, sizeof(cand_edge), cand_edge_compare);
+
+    // kruskal
+    for(int i=0; i<nnodes; i++){
+        parent[i] = i;
+        size[i] = 1;
+    }
+    int ntree = 0;
+    for(size_t e=0; e<nedges && ntree < nnodes - 2; e++){
+        int ru = cand_find(parent, edges[e].u);
+        int rv = cand_find(parent, edges[e].v);
+        if(ru == rv){
+            continue;
+        }
+        if(size[ru] < size[rv]){
+            int tmp = ru; ru = rv; rv = tmp;
+        }
+        parent[rv] = ru;
+        size[ru] += size[rv];
+
+        tree_u[ntree] = edges[e].u;
+        tree_v[ntree] = edges[e].v;
+        tree_w[ntree] = edges[e].w;
+        adj_count[edges[e].u + 1]++;
+        adj_count[edges[e].v + 1]++;
+        ntree++;
+    }
+    free(edges);
+
+    // adjacency of the forest in CSR layout
+    for(int i=0; i<nnodes; i++){
+        adj_count[i + 1] += adj_count[i];
+    }
+    int* adj = (int*) malloc((2 * (size_t)ntree + 1) * sizeof(int));
+    float* adj_w = (float*) malloc((2 * (size_t)ntree + 1) * sizeof(float));
+    if(adj == NULL || adj_w == NULL){
+        free(adj); free(adj_w); free(parent); free(size); free(adj_count); free(tree_u); free(tree_v); free(tree_w);
+        cand_free_tree(t);
+        return RESOURCE_EXHAUSTED;
+    }
+    int* fill = size;
+    for(int i=0; i<nnodes; i++){
+        fill[i] = adj_count[i];
+    }
+    for(int e=0; e<ntree; e++){
+        adj[fill[tree_u[e]]] = tree_v[e];
+        adj_w[fill[tree_u[e]]++] = tree_w[e];
+        adj[fill[tree_v[e]]] = tree_u[e];
+        adj_w[fill[tree_v[e]]++] = tree_w[e];
+    }
+
+    // root every tree of the forest with a BFS, the queue reuses parent
+    int* queue = parent;
+    for(int i=0; i<nnodes; i++){
+        t->component[i] = -1;
+    }
+    for(int r=0; r<nnodes; r++){
+        if(t->component[r] != -1){
+            continue;
+        }
+        int head = 0, tail = 0;
+        queue[tail++] = r;
+        t->component[r] = r;
+        t->depth[r] = 0;
+        t->up[r] = r;
+        t->max_edge[r] = 0;
+        while(head < tail){
+            int u = queue[head++];
+            for(int a=adj_count[u]; a<adj_count[u + 1]; a++){
+                int v = adj[a];
+                if(t->component[v] != -1){
+                    continue;
+                }
+                t->component[v] = r;
+                t->depth[v] = t->depth[u] + 1;
+                t->up[v] = u;
+                t->max_edge[v] = adj_w[a];
+                queue[tail++] = v;
+            }
+        }
+    }
+
+    for(int l=1; l<t->levels; l++){
+        int* up = t->up + (size_t)l * nnodes;
+        int* up_prev = t->up + (size_t)(l - 1) * nnodes;
+        float* mx = t->max_edge + (size_t)l * nnodes;
+        float* mx_prev = t->max_edge + (size_t)(l - 1) * nnodes;
+        for(int v=0; v<nnodes; v++){
+            int mid = up_prev[v];
+            up[v] = up_prev[mid];
+            mx[v] = mx_prev[v] > mx_prev[mid] ? mx_prev[v] : mx_prev[mid];
+        }
+    }
+
+    free(adj);
+    free(adj_w);
+    free(parent);
+    free(size);
+    free(adj_count);
+    free(tree_u);
+    free(tree_v);
+    free(tree_w);
+
+    return OK;
+}
+
+/**
+ * @brief Longest edge on the tree path between u and v, -1 if they are in different trees
+ */
+static float cand_path_max(const cand_tree* t, int u, int v){
+    if(t->component[u] != t->component[v]){
+        return -1;
+    }
+
+    size_t n = t->nnodes;
+    float best = 0;
+    if(t->depth[u] < t->depth[v]){
+        int tmp = u; u = v; v = tmp;
+    }
+
+    int diff = t->depth[u] - t->depth[v];
+    for(int l=0; diff > 0; l++, diff >>= 1){
+        if(diff & 1){
+            if(t->max_edge[l * n + u] > best) best = t->max_edge[l * n + u];
+            u = t->up[l * n + u];
+        }
+    }
+    if(u == v){
+        return best;
+    }
+
+    for(int l=t->levels-1; l>=0; l--){
+        if(t->up[l * n + u] != t->up[l * n + v]){
+            if(t->max_edge[l * n + u] > best) best = t->max_edge[l * n + u];
+            if(t->max_edge[l * n + v] > best) best = t->max_edge[l * n + v];
+            u = t->up[l * n + u];
+            v = t->up[l * n + v];
+        }
+    }
+    if(t->max_edge[u] > best) best = t->max_edge[u];
+    if(t->max_edge[v] > best) best = t->max_edge[v];
+
+    return best;
+}
+
+static void cand_free_tree(cand_tree* t){
+    free(t->component);
+    free(t->depth);
+    free(t->up);
+    free(t->max_edge);
+}
+
+typedef struct {
+    const point* points;
+    const cand_tree* tree;
+    int nnodes;
+    int width;                  // superset neighbors per node
+    int k;                      // alpha neighbors kept per node
+    const int* lists;
+    int* counts;
+    double special_second;      // second shortest edge of the special node 0
+    int* out;                   // nnodes x k alpha neighbors
+    ERROR_CODE e;               // RESOURCE_EXHAUSTED if a worker cannot allocate its scratch
+} cand_alpha_job;
+
+/**
+ * @brief alpha(i, j): increase of the minimum 1-tree length when edge i-j is forced in it
+ */
+static double cand_alpha(const cand_alpha_job* job, int i, int j){
+    double c = cand_distance(job->points, i, j);
+    if(i == 0 || j == 0){
+        double alpha = c - job->special_second;
+        return alpha > 0 ? alpha : 0;
+    }
+
+    float beta = cand_path_max(job->tree, i, j);
+    if(beta < 0){
+        return 0;
+    }
+    return c - beta;
+}
+
+static void cand_alpha_task(void* ctx, int thread_id, int nthreads){
+    cand_alpha_job* job = (cand_alpha_job*) ctx;
+    double* alpha = (double*) malloc(job->width * sizeof(double));
+    int* order = (int*) malloc(job->width * sizeof(int));
+    if(alpha == NULL || order == NULL){
+        free(alpha);
+        free(order);
+        __atomic_store_n(&job->e, RESOURCE_EXHAUSTED, __ATOMIC_RELAXED);
+        return;
+    }
+
+    for(int i=thread_id; i<job->nnodes; i+=nthreads){
+        const int* list = job->lists + (size_t)i * job->width;
+        int count = job->counts[i];
+
+        // the superset is sorted by distance, a stable insertion sort breaks alpha ties by distance
+        for(int c=0; c<count; c++){
+            double a = cand_alpha(job, i, list[c]);
+            int j = c - 1;
+            while(j >= 0 && alpha[j] > a){
+                alpha[j + 1] = alpha[j];
+                order[j + 1] = order[j];
+                j--;
+            }
+            alpha[j + 1] = a;
+            order[j + 1] = list[c];
+        }
+
+        int keep = count < job->k ? count : job->k;
+        memcpy(job->out + (size_t)i * job->k, order, keep * sizeof(int));
+        job->counts[i] = keep;
+    }
+
+    free(alpha);
+    free(order);
+}
+
+//================================================================================
+// LISTS
+//================================================================================
+
+ERROR_CODE cand_build(candidate_list* cl, const point* points, int nnodes, candidate_type type, int k, int nthreads){
+    cl->type = type;
+    cl->nnodes = nnodes;
+    cl->k = k < nnodes - 1 ? k : nnodes - 1;
+    cl->offsets = NULL;
+    cl->neighbors = NULL;
+
+    if(type == CAND_NONE || cl->k <= 0){
+        cl->type = CAND_NONE;
+        return OK;
+    }
+
+    kdtree tree;
+    ERROR_CODE e = kd_build(&tree, points, nnodes);
+    if(!err_ok(e)){
+        return e;
+    }
+
+    // alpha-nearness picks its lists out of a quadrant superset twice as long
+    cand_job job;
+    job.tree = &tree;
+    job.points = points;
+    job.nnodes = nnodes;
+    job.type = type == CAND_ALPHA ? CAND_QUADRANT : type;
+    job.width = type == CAND_ALPHA ? (2 * cl->k < nnodes - 1 ? 2 * cl->k : nnodes - 1) : cl->k;
+    job.lists = (int*) malloc((size_t)nnodes * job.width * sizeof(int));
+    job.counts = (int*) malloc(nnodes * sizeof(int));
+    if(job.lists == NULL || job.counts == NULL){
+        free(job.lists);
+        free(job.counts);
+        kd_free(&tree);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    job.e = OK;
+    threads_run(nthreads, cand_query_task, &job);
+    kd_free(&tree);
+    if(job.e != OK){
+        free(job.lists);
+        free(job.counts);
+        return job.e;
+    }
+
+    int* lists = job.lists;
+    int width = job.width;
+
+    if(type == CAND_ALPHA){
+        cand_tree t;
+        e = cand_build_tree(&t, points, nnodes, job.lists, job.counts, job.width);
+        if(!err_ok(e)){
+            free(job.lists);
+            free(job.counts);
+            return e;
+        }
+
+        cand_alpha_job alpha_job;
+        alpha_job.points = points;
+        alpha_job.tree = &t;
+        alpha_job.nnodes = nnodes;
+        alpha_job.width = job.width;
+        alpha_job.k = cl->k;
+        alpha_job.lists = job.lists;
+        alpha_job.counts = job.counts;
+        alpha_job.special_second = job.counts[0] > 1 ? cand_distance(points, 0, job.lists[1]) : 0;
+        alpha_job.out = (int*) malloc((size_t)nnodes * cl->k * sizeof(int));
+        if(alpha_job.out == NULL){
+            cand_free_tree(&t);
+            free(job.lists);
+            free(job.counts);
+            return RESOURCE_EXHAUSTED;
+        }
+
+        alpha_job.e = OK;
+        threads_run(nthreads, cand_alpha_task, &alpha_job);
+        cand_free_tree(&t);
+
+        free(job.lists);
+        if(alpha_job.e != OK){
+            free(alpha_job.out);
+            free(job.counts);
+            return alpha_job.e;
+        }
+        lists = alpha_job.out;
+        width = cl->k;
+    }
+
+    // compact into CSR
+    cl->offsets = (int*) malloc((nnodes + 1) * sizeof(int));
+    if(cl->offsets == NULL){
+        free(lists);
+        free(job.counts);
+        return RESOURCE_EXHAUSTED;
+    }
+    cl->offsets[0] = 0;
+    for(int i=0; i<nnodes; i++){
+        cl->offsets[i + 1] = cl->offsets[i] + job.counts[i];
+    }
+    cl->neighbors = (int*) malloc((cl->offsets[nnodes] + 1) * sizeof(int));
+    if(cl->neighbors == NULL){
+        free(cl->offsets);
+        cl->offsets = NULL;
+        free(lists);
+        free(job.counts);
+        return RESOURCE_EXHAUSTED;
+    }
+    for(int i=0; i<nnodes; i++){
+        memcpy(cl->neighbors + cl->offsets[i], lists + (size_t)i * width, job.counts[i] * sizeof(int));
+    }
+
+    free(lists);
+    free(job.counts);
+
+    return OK;
+}
+
+void cand_free(candidate_list* cl){
+    free(cl->offsets);
+    free(cl->neighbors);
+    cl->offsets = NULL;
+    cl->neighbors = NULL;
+    cl->type = CAND_NONE;
+}
@@ -0,0 +1,85 @@
+#ifndef CANDIDATES_H_
+#define CANDIDATES_H_
+
+/**
+ * @file candidates.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Candidate neighbor lists used to restrict local search moves
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include "kdtree.h"
+
+#define DEFAULT_CANDIDATES 10
+
+/**
+ * @brief How the neighbors of a node are chosen
+ * 
+ */
+typedef enum {
+    CAND_NONE = 0,              // no candidate lists
+    CAND_KNN = 1,               // k nearest nodes
+    CAND_QUADRANT = 2,          // k/4 nearest nodes in each quadrant, filled up with the nearest ones
+    CAND_ALPHA = 3              // k nodes with smallest alpha-nearness on the 1-tree
+} candidate_type;
+
+/**
+ * @brief Neighbor lists in CSR layout: the neighbors of node i are
+ * neighbors[offsets[i]] ... neighbors[offsets[i+1] - 1], best first
+ * 
+ */
+typedef struct {
+    candidate_type type;
+    int nnodes;
+    int k;                      // maximum length of a list
+    int* offsets;               // nnodes + 1 offsets into neighbors
+    int* neighbors;             // concatenated lists
+} candidate_list;
+
+/**
+ * @brief Builds the candidate lists with a k-d tree in O(n log n)
+ * 
+ * @param cl candidate lists to fill
+ * @param points points of the instance
+ * @param nnodes number of points
+ * @param type how neighbors are chosen
+ * @param k maximum number of neighbors per node
+ * @param nthreads number of threads running the queries
+ * @return ERROR_CODE 
+ */
+ERROR_CODE cand_build(candidate_list* cl, const point* points, int nnodes, candidate_type type, int k, int nthreads);
+
+/**
+ * @brief Neighbors of node i
+ * 
+ * @param cl 
+ * @param i 
+ * @return const int* first neighbor of i
+ */
+static inline const int* cand_neighbors(const candidate_list* cl, int i){
+    return cl->neighbors + cl->offsets[i];
+}
+
+/**
+ * @brief Number of neighbors of node i
+ * 
+ * @param cl 
+ * @param i 
+ * @return int 
+ */
+static inline int cand_count(const candidate_list* cl, int i){
+    return cl->offsets[i + 1] - cl->offsets[i];
+}
+
+/**
+ * @brief Frees all resources of the candidate lists
+ * 
+ * @param cl 
+ */
+void cand_free(candidate_list* cl);
+
+#endif
@@ -0,0 +1,50 @@
+#include "deadline.h"
+
+static double deadline_now(clockid_t clock){
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (double) ts.tv_sec + (double) ts.tv_nsec * 1e-9;
+}
+
+void deadline_init(deadline* d){
+    d->clock = CLOCK_MONOTONIC;
+#ifdef CLOCK_MONOTONIC_COARSE
+    // the coarse clock skips the hardware counter, it is used only if its ticks are short enough
+    struct timespec res;
+    if(clock_getres(CLOCK_MONOTONIC_COARSE, &res) == 0 && res.tv_sec == 0 && res.tv_nsec * 1e-9 <= DEADLINE_COARSE_RESOLUTION){
+        d->clock = CLOCK_MONOTONIC_COARSE;
+    }
+#endif
+
+    d->start = deadline_now(d->clock);
+    d->limit = -1;
+    d->stop = 0;
+}
+
+void deadline_set(deadline* d, double seconds){
+    d->limit = seconds;
+}
+
+double deadline_elapsed(const deadline* d){
+    return deadline_now(d->clock) - d->start;
+}
+
+double deadline_timestamp(void){
+    return deadline_now(CLOCK_MONOTONIC);
+}
+
+bool deadline_expired(deadline* d){
+    if(deadline_stopped(d)){
+        return true;
+    }
+    if(d->limit < 0 || deadline_elapsed(d) <= d->limit){
+        return false;
+    }
+
+    deadline_stop(d);
+    return true;
+}
+
+void deadline_stop(deadline* d){
+    __atomic_store_n(&d->stop, 1, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,108 @@
+#ifndef DEADLINE_H_
+#define DEADLINE_H_
+
+/**
+ * @file deadline.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Wall-clock deadline on CLOCK_MONOTONIC, with a stop flag polled by every worker
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <stdbool.h>
+#include <time.h>
+
+#define DEADLINE_COARSE_RESOLUTION 0.005    // coarsest resolution, in seconds, at which CLOCK_MONOTONIC_COARSE is used
+#define DEADLINE_PERIOD 256                 // calls of deadline_poll between two reads of the clock in the hot loops
+
+/**
+ * @brief Deadline shared by all the workers of a run. The clock is read only by deadline_expired,
+ * hot loops call deadline_poll, which reads it once every period calls and the stop flag otherwise
+ * 
+ */
+typedef struct {
+    clockid_t clock;            // CLOCK_MONOTONIC_COARSE if it is fine enough, else CLOCK_MONOTONIC
+    double start;               // time at which the run started, in seconds
+    double limit;               // seconds from start, negative for no limit
+    int stop;                   // set, atomically, once the deadline has passed or the run is stopped
+} deadline;
+
+/**
+ * @brief Starts the clock of the run, without limit
+ * 
+ * @param d 
+ */
+void deadline_init(deadline* d);
+
+/**
+ * @brief Sets the limit, counted from deadline_init
+ * 
+ * @param d 
+ * @param seconds negative for no limit
+ */
+void deadline_set(deadline* d, double seconds);
+
+/**
+ * @brief Seconds of wall time since deadline_init
+ * 
+ * @param d 
+ * @return double 
+ */
+double deadline_elapsed(const deadline* d);
+
+/**
+ * @brief Seconds on CLOCK_MONOTONIC at full resolution, to time phases shorter than the
+ * ticks of the coarse clock
+ * 
+ * @return double 
+ */
+double deadline_timestamp(void);
+
+/**
+ * @brief Reads the clock and sets the stop flag if the limit has passed
+ * 
+ * @param d 
+ * @return true if the run must stop
+ */
+bool deadline_expired(deadline* d);
+
+/**
+ * @brief Stops the run, as if the deadline had passed
+ * 
+ * @param d 
+ */
+void deadline_stop(deadline* d);
+
+/**
+ * @brief Stop flag, without reading the clock
+ * 
+ * @param d 
+ * @return true if the run must stop
+ */
+static inline bool deadline_stopped(const deadline* d){
+    return __atomic_load_n(&d->stop, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Amortized check for hot loops: the stop flag at every call, the clock once every period calls
+ * 
+ * @param d 
+ * @param countdown calls left before the next read of the clock, owned by the caller and initialized to period
+ * @param period 
+ * @return true if the run must stop
+ */
+static inline bool deadline_poll(deadline* d, int* countdown, int period){
+    if(deadline_stopped(d)){
+        return true;
+    }
+    if(--(*countdown) > 0){
+        return false;
+    }
+    *countdown = period;
+    return deadline_expired(d);
+}
+
+#endif
@@ -0,0 +1,366 @@
+#include "kdtree.h"
+
+/**
+ * @brief Bounded max-heap of the best points found by a query
+ */
+typedef struct {
+    double x;
+    double y;
+    int k;
+    int exclude;
+    int quadrant;
+    int size;
+    int* heap;                  // positions in the tree
+    double* heap_dist;          // squared distances, heap_dist[0] is the worst
+} kd_query;
+
+static inline double kd_coord(const kdtree* tree, int pos, int dim){
+    return dim == 0 ? tree->xs[pos] : tree->ys[pos];
+}
+
+static void kd_swap(kdtree* tree, int a, int b){
+    int ti = tree->index[a]; tree->index[a] = tree->index[b]; tree->index[b] = ti;
+    double tx = tree->xs[a]; tree->xs[a] = tree->xs[b]; tree->xs[b] = tx;
+    double ty = tree->ys[a]; tree->ys[a] = tree->ys[b]; tree->ys[b] = ty;
+}
+
+/**
+ * @brief Quickselect: places the k-th smallest coordinate of [lo, hi) at position k
+ */
+static void kd_select(kdtree* tree, int lo, int hi, int k, int dim){
+    hi--;
+    while(hi > lo){
+        // median of three as pivot
+        int mid = lo + (hi - lo) / 2;
+        if(kd_coord(tree, mid, dim) < kd_coord(tree, lo, dim)) kd_swap(tree, mid, lo);
+        if(kd_coord(tree, hi, dim) < kd_coord(tree, lo, dim)) kd_swap(tree, hi, lo);
+        if(kd_coord(tree, hi, dim) < kd_coord(tree, mid, dim)) kd_swap(tree, hi, mid);
+        double pivot = kd_coord(tree, mid, dim);
+
+        int i = lo, j = hi;
+        while(i <= j){
+            while(kd_coord(tree, i, dim) < pivot) i++;
+            while(kd_coord(tree, j, dim) > pivot) j--;
+            if(i <= j){
+                kd_swap(tree, i, j);
+                i++;
+                j--;
+            }
+        }
+
+        if(k <= j){
+            hi = j;
+        }else if(k >= i){
+            lo = i;
+        }else{
+            return;
+        }
+    }
+}
+
+static void kd_build_range(kdtree* tree, int lo, int hi){
+    if(hi - lo <= 0){
+        return;
+    }
+
+    // split on the dimension with the largest spread
+    double min_x = __DBL_MAX__, max_x = -__DBL_MAX__, min_y = __DBL_MAX__, max_y = -__DBL_MAX__;
+    for(int p=lo; p<hi; p++){
+        if(tree->xs[p] < min_x) min_x = tree->xs[p];
+        if(tree->xs[p] > max_x) max_x = tree->xs[p];
+        if(tree->ys[p] < min_y) min_y = tree->ys[p];
+        if(tree->ys[p] > max_y) max_y = tree->ys[p];
+    }
+    int dim = (max_y - min_y) > (max_x - min_x);
+
+    int m = lo + (hi - lo) / 2;
+    kd_select(tree, lo, hi, m, dim);
+    tree->dim[m] = (char) dim;
+    tree->count[m] = hi - lo;
+
+    kd_build_range(tree, lo, m);
+    kd_build_range(tree, m + 1, hi);
+}
+
+ERROR_CODE kd_build(kdtree* tree, const point* points, int npoints){
+    tree->npoints = npoints;
+    tree->forked = false;
+    tree->index = (int*) malloc(npoints * sizeof(int));
+    tree->xs = (double*) malloc(npoints * sizeof(double));
+    tree->ys = (double*) malloc(npoints * sizeof(double));
+    tree->dim = (char*) malloc(npoints * sizeof(char));
+    tree->position = (int*) malloc(npoints * sizeof(int));
+    tree->alive = (char*) malloc(npoints * sizeof(char));
+    tree->count = (int*) malloc(npoints * sizeof(int));
+    if(tree->index == NULL || tree->xs == NULL || tree->ys == NULL || tree->dim == NULL ||
+       tree->position == NULL || tree->alive == NULL || tree->count == NULL){
+        kd_free(tree);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    for(int i=0; i<npoints; i++){
+        tree->index[i] = i;
+        tree->xs[i] = points[i].x;
+        tree->ys[i] = points[i].y;
+    }
+
+    kd_build_range(tree, 0, npoints);
+
+    for(int p=0; p<npoints; p++){
+        tree->position[tree->index[p]] = p;
+        tree->alive[p] = 1;
+    }
+
+    return OK;
+}
+
+ERROR_CODE kd_fork(kdtree* fork, const kdtree* src){
+    *fork = *src;
+    fork->forked = true;
+    fork->alive = (char*) malloc(src->npoints * sizeof(char));
+    fork->count = (int*) malloc(src->npoints * sizeof(int));
+    if(fork->alive == NULL || fork->count == NULL){
+        kd_free(fork);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    memcpy(fork->alive, src->alive, src->npoints * sizeof(char));
+    memcpy(fork->count, src->count, src->npoints * sizeof(int));
+
+    return OK;
+}
+
+//================================================================================
+// DELETION
+//================================================================================
+
+void kd_delete(kdtree* tree, int index){
+    int pos = tree->position[index];
+    if(!tree->alive[pos]){
+        return;
+    }
+    tree->alive[pos] = 0;
+
+    // every subtree on the way from the root to pos loses one alive point
+    int lo = 0, hi = tree->npoints;
+    while(hi - lo > 0){
+        int m = lo + (hi - lo) / 2;
+        tree->count[m]--;
+        if(pos == m){
+            return;
+        }
+        if(pos < m){
+            hi = m;
+        }else{
+            lo = m + 1;
+        }
+    }
+}
+
+static void kd_restore_range(kdtree* tree, int lo, int hi){
+    if(hi - lo <= 0){
+        return;
+    }
+    int m = lo + (hi - lo) / 2;
+    tree->count[m] = hi - lo;
+    kd_restore_range(tree, lo, m);
+    kd_restore_range(tree, m + 1, hi);
+}
+
+void kd_restore(kdtree* tree){
+    memset(tree->alive, 1, tree->npoints * sizeof(char));
+    kd_restore_range(tree, 0, tree->npoints);
+}
+
+//================================================================================
+// QUERIES
+//================================================================================
+
+static void kd_heap_push(kd_query* q, int pos, double d){
+    if(q->size < q->k){
+        // sift up
+        int c = q->size++;
+        while(c > 0){
+            int p = (c - 1) / 2;
+            if(q->heap_dist[p] >= d) break;
+            q->heap[c] = q->heap[p];
+            q->heap_dist[c] = q->heap_dist[p];
+            c = p;
+        }
+        q->heap[c] = pos;
+        q->heap_dist[c] = d;
+        return;
+    }
+
+    if(d >= q->heap_dist[0]){
+        return;
+    }
+
+    // replace the worst and sift down
+    int c = 0;
+    while(true){
+        int l = 2 * c + 1, r = l + 1, big = c;
+        double big_d = d;
+        if(l < q->size && q->heap_dist[l] > big_d){ big = l; big_d = q->heap_dist[l]; }
+        if(r < q->size && q->heap_dist[r] > big_d){ big = r; big_d = q->heap_dist[r]; }
+        if(big == c) break;
+        q->heap[c] = q->heap[big];
+        q->heap_dist[c] = q->heap_dist[big];
+        c = big;
+    }
+    q->heap[c] = pos;
+    q->heap_dist[c] = d;
+}
+
+static void kd_search(const kdtree* tree, int lo, int hi, kd_query* q){
+    if(hi - lo <= 0){
+        return;
+    }
+
+    int m = lo + (hi - lo) / 2;
+    if(tree->count[m] == 0){
+        return;
+    }
+    int dim = tree->dim[m];
+    double px = tree->xs[m], py = tree->ys[m];
+
+    if(tree->alive[m] && tree->index[m] != q->exclude && (q->quadrant == KD_ANY_QUADRANT || kd_quadrant(q->x, q->y, px, py) == q->quadrant)){
+        double dx = px - q->x, dy = py - q->y;
+        kd_heap_push(q, m, dx * dx + dy * dy);
+    }
+
+    double split = dim == 0 ? px : py;
+    double diff = (dim == 0 ? q->x : q->y) - split;
+
+    // the left subtree has coordinates <= split, the right one >= split
+    bool skip_left = false, skip_right = false;
+    if(q->quadrant != KD_ANY_QUADRANT){
+        bool below = (q->quadrant >> dim) & 1;       // quadrant wants coordinates < query
+        skip_left = !below && split < (dim == 0 ? q->x : q->y);
+        skip_right = below && split >= (dim == 0 ? q->x : q->y);
+    }
+
+    bool left_first = diff < 0;
+    for(int side=0; side<2; side++){
+        bool left = (side == 0) == left_first;
+        if(left ? skip_left : skip_right){
+            continue;
+        }
+        // the far side is visited only if the splitting line is closer than the worst point
+        if(side == 1 && q->size == q->k && diff * diff >= q->heap_dist[0]){
+            continue;
+        }
+        if(left){
+            kd_search(tree, lo, m, q);
+        }else{
+            kd_search(tree, m + 1, hi, q);
+        }
+    }
+}
+
+int kd_knn(const kdtree* tree, double x, double y, int k, int exclude, int quadrant, int* out, double* out_dist){
+    if(k <= 0){
+        return 0;
+    }
+
+    kd_query q;
+    q.x = x;
+    q.y = y;
+    q.k = k;
+    q.exclude = exclude;
+    q.quadrant = quadrant;
+    q.size = 0;
+    q.heap = (int*) malloc(k * sizeof(int));
+    q.heap_dist = (double*) malloc(k * sizeof(double));
+
+    kd_search(tree, 0, tree->npoints, &q);
+
+    // sort by distance, ties broken by original index
+    int found = q.size;
+    for(int c=1; c<found; c++){
+        int pos = q.heap[c];
+        double d = q.heap_dist[c];
+        int j = c - 1;
+        while(j >= 0 && (q.heap_dist[j] > d || (q.heap_dist[j] == d && tree->index[q.heap[j]] > tree->index[pos]))){
+            q.heap[j + 1] = q.heap[j];
+            q.heap_dist[j + 1] = q.heap_dist[j];
+            j--;
+        }
+        q.heap[j + 1] = pos;
+        q.heap_dist[j + 1] = d;
+    }
+
+    for(int c=0; c<found; c++){
+        out[c] = tree->index[q.heap[c]];
+        if(out_dist != NULL){
+            out_dist[c] = q.heap_dist[c];
+        }
+    }
+
+    free(q.heap);
+    free(q.heap_dist);
+
+    return found;
+}
+
+static void kd_search_nearest(const kdtree* tree, int lo, int hi, double x, double y, int* best, double* best_dist){
+    if(hi - lo <= 0){
+        return;
+    }
+
+    int m = lo + (hi - lo) / 2;
+    if(tree->count[m] == 0){
+        return;
+    }
+
+    double px = tree->xs[m], py = tree->ys[m];
+    if(tree->alive[m]){
+        double dx = px - x, dy = py - y;
+        double d = dx * dx + dy * dy;
+        if(d < *best_dist || (d == *best_dist && tree->index[m] < tree->index[*best])){
+            *best = m;
+            *best_dist = d;
+        }
+    }
+
+    double diff = tree->dim[m] == 0 ? x - px : y - py;
+    if(diff < 0){
+        kd_search_nearest(tree, lo, m, x, y, best, best_dist);
+        if(diff * diff <= *best_dist){
+            kd_search_nearest(tree, m + 1, hi, x, y, best, best_dist);
+        }
+    }else{
+        kd_search_nearest(tree, m + 1, hi, x, y, best, best_dist);
+        if(diff * diff <= *best_dist){
+            kd_search_nearest(tree, lo, m, x, y, best, best_dist);
+        }
+    }
+}
+
+int kd_nearest(const kdtree* tree, double x, double y){
+    int best = -1;
+    double best_dist = __DBL_MAX__;
+
+    kd_search_nearest(tree, 0, tree->npoints, x, y, &best, &best_dist);
+
+    return best == -1 ? -1 : tree->index[best];
+}
+
+void kd_free(kdtree* tree){
+    if(!tree->forked){
+        free(tree->index);
+        free(tree->xs);
+        free(tree->ys);
+        free(tree->dim);
+        free(tree->position);
+    }
+    free(tree->alive);
+    free(tree->count);
+    tree->index = NULL;
+    tree->xs = NULL;
+    tree->ys = NULL;
+    tree->dim = NULL;
+    tree->position = NULL;
+    tree->alive = NULL;
+    tree->count = NULL;
+}
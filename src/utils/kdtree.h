@@ -0,0 +1,113 @@
+#ifndef KDTREE_H_
+#define KDTREE_H_
+
+/**
+ * @file kdtree.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief 2D k-d tree over the points of an instance
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include "utils.h"
+
+#define KD_ANY_QUADRANT -1
+
+/**
+ * @brief Implicit balanced k-d tree: the subtree of range [lo, hi) has its splitting
+ * point at (lo + hi) / 2, points are stored in tree order as SoA for cache locality.
+ * Points can be deleted, subtrees without alive points are skipped by the queries
+ * 
+ */
+typedef struct {
+    int npoints;
+    int* index;                 // original index of the point at each position
+    int* position;              // position of each original index
+    double* xs;                 // x coordinate of the point at each position
+    double* ys;                 // y coordinate of the point at each position
+    char* dim;                  // splitting dimension of the subtree rooted at each position, 0 = x, 1 = y
+    char* alive;                // 1 if the point at each position has not been deleted
+    int* count;                 // alive points in the subtree rooted at each position
+    bool forked;                // index, position, xs, ys and dim belong to the tree it was forked from
+} kdtree;
+
+/**
+ * @brief Builds the tree in O(n log n)
+ * 
+ * @param tree 
+ * @param points 
+ * @param npoints 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE kd_build(kdtree* tree, const point* points, int npoints);
+
+/**
+ * @brief Quadrant of (x, y) with respect to (qx, qy): bit 0 set if x < qx, bit 1 set if y < qy
+ * 
+ */
+static inline int kd_quadrant(double qx, double qy, double x, double y){
+    return (x < qx) | ((y < qy) << 1);
+}
+
+/**
+ * @brief Finds the k points nearest to (x, y), sorted by increasing distance
+ * 
+ * @param tree 
+ * @param x query x coordinate
+ * @param y query y coordinate
+ * @param k maximum number of points returned
+ * @param exclude original index to skip, -1 for none
+ * @param quadrant only points in this quadrant of (x, y) as in kd_quadrant, KD_ANY_QUADRANT for all
+ * @param out original indices of the points found
+ * @param out_dist squared distances of the points found, can be NULL
+ * @return int number of points found
+ */
+int kd_knn(const kdtree* tree, double x, double y, int k, int exclude, int quadrant, int* out, double* out_dist);
+
+/**
+ * @brief Finds the alive point nearest to (x, y)
+ * 
+ * @param tree 
+ * @param x query x coordinate
+ * @param y query y coordinate
+ * @return int original index of the nearest point, -1 if all points are deleted
+ */
+int kd_nearest(const kdtree* tree, double x, double y);
+
+/**
+ * @brief Makes a tree that shares the structure of src but has its own deletions,
+ * so that threads can run deletions and queries on the same points concurrently.
+ * src must outlive the fork
+ * 
+ * @param fork 
+ * @param src built tree
+ * @return ERROR_CODE 
+ */
+ERROR_CODE kd_fork(kdtree* fork, const kdtree* src);
+
+/**
+ * @brief Deletes a point in O(log n)
+ * 
+ * @param tree 
+ * @param index original index of the point
+ */
+void kd_delete(kdtree* tree, int index);
+
+/**
+ * @brief Makes all points alive again in O(n)
+ * 
+ * @param tree 
+ */
+void kd_restore(kdtree* tree);
+
+/**
+ * @brief Frees all resources of the tree
+ * 
+ * @param tree 
+ */
+void kd_free(kdtree* tree);
+
+#endif
@@ -0,0 +1,77 @@
+#include "rng.h"
+
+static inline uint64_t rng_rotl(uint64_t x, int k){
+    return (x << k) | (x >> (64 - k));
+}
+
+void rng_seed(rng_state* rng, uint64_t seed){
+    // splitmix64, never gives the all-zero state
+    for(int i=0; i<4; i++){
+        uint64_t z = (seed += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        rng->s[i] = z ^ (z >> 31);
+    }
+}
+
+uint64_t rng_next(rng_state* rng){
+    uint64_t* s = rng->s;
+    uint64_t result = rng_rotl(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+
+    s[2] ^= s[0];
+    s[3] ^= s[1];
+    s[1] ^= s[2];
+    s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rng_rotl(s[3], 45);
+
+    return result;
+}
+
+void rng_jump(rng_state* rng){
+    static const uint64_t jump[] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL, 0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+
+    uint64_t s[4] = {0, 0, 0, 0};
+    for(int i=0; i<4; i++){
+        for(int b=0; b<64; b++){
+            if(jump[i] & (1ULL << b)){
+                for(int w=0; w<4; w++){
+                    s[w] ^= rng->s[w];
+                }
+            }
+            rng_next(rng);
+        }
+    }
+
+    for(int w=0; w<4; w++){
+        rng->s[w] = s[w];
+    }
+}
+
+void rng_stream(rng_state* rng, const rng_state* base, int index){
+    *rng = *base;
+    for(int i=0; i<=index; i++){
+        rng_jump(rng);
+    }
+}
+
+double rng_double(rng_state* rng){
+    return (rng_next(rng) >> 11) * 0x1.0p-53;
+}
+
+int rng_int(rng_state* rng, int bound){
+    // the high word of a 32x32 bit product is uniform once the low words below 2^32 mod bound are rejected
+    uint32_t range = (uint32_t) bound;
+    uint64_t m = (uint64_t)(uint32_t)(rng_next(rng) >> 32) * range;
+    uint32_t low = (uint32_t) m;
+    if(low < range){
+        uint32_t threshold = -range % range;
+        while(low < threshold){
+            m = (uint64_t)(uint32_t)(rng_next(rng) >> 32) * range;
+            low = (uint32_t) m;
+        }
+    }
+
+    return (int)(m >> 32);
+}
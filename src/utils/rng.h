@@ -0,0 +1,78 @@
+#ifndef RNG_H_
+#define RNG_H_
+
+/**
+ * @file rng.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Reentrant xoshiro256** generator, with jump-ahead for independent parallel streams
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <stdint.h>
+
+// https://prng.di.unimi.it/xoshiro256starstar.c
+
+/**
+ * @brief State of a stream, every worker owns its own
+ * 
+ */
+typedef struct {
+    uint64_t s[4];
+} rng_state;
+
+/**
+ * @brief Seeds the stream, the four words are expanded from seed with splitmix64
+ * 
+ * @param rng 
+ * @param seed 
+ */
+void rng_seed(rng_state* rng, uint64_t seed);
+
+/**
+ * @brief Next 64 random bits
+ * 
+ * @param rng 
+ * @return uint64_t 
+ */
+uint64_t rng_next(rng_state* rng);
+
+/**
+ * @brief Advances the stream by 2^128 draws, so that streams jumped a different number of
+ * times never overlap
+ * 
+ * @param rng 
+ */
+void rng_jump(rng_state* rng);
+
+/**
+ * @brief Stream of worker index: base jumped index + 1 times, so it does not overlap base
+ * nor the streams of the other workers
+ * 
+ * @param rng stream of the worker
+ * @param base stream of the caller, not modified
+ * @param index index of the worker
+ */
+void rng_stream(rng_state* rng, const rng_state* base, int index);
+
+/**
+ * @brief Uniform double in [0, 1), with 53 random bits
+ * 
+ * @param rng 
+ * @return double 
+ */
+double rng_double(rng_state* rng);
+
+/**
+ * @brief Uniform integer in [0, bound) without modulo bias (Lemire's method)
+ * 
+ * @param rng 
+ * @param bound positive
+ * @return int 
+ */
+int rng_int(rng_state* rng, int bound);
+
+#endif
@@ -0,0 +1,444 @@
+#include "simd.h"
+
+#include <math.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+//================================================================================
+// DISPATCH
+//================================================================================
+
+simd_level simd_detect(void){
+    static int level = -1;
+
+    if(level < 0){
+        int detected = SIMD_SCALAR;
+#ifdef SIMD_X86
+        __builtin_cpu_init();
+        if(__builtin_cpu_supports("avx512f")){
+            detected = SIMD_AVX512;
+        }else if(__builtin_cpu_supports("avx2")){
+            detected = SIMD_AVX2;
+        }
+#endif
+        log_debug("simd level: %d", detected);
+        level = detected;
+    }
+
+    return (simd_level) level;
+}
+
+//================================================================================
+// DISTANCES
+//================================================================================
+
+static void distance_row_scalar(const double* xs, const double* ys, double x, double y, int len, double* out){
+    for(int k=0; k<len; k++){
+        double dx = xs[k] - x;
+        double dy = ys[k] - y;
+        out[k] = sqrtf(dx * dx + dy * dy);
+    }
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static void distance_row_avx2(const double* xs, const double* ys, double x, double y, int len, double* out){
+    __m256d vx = _mm256_set1_pd(x);
+    __m256d vy = _mm256_set1_pd(y);
+
+    int k = 0;
+    for(; k + 4 <= len; k += 4){
+        __m256d dx = _mm256_sub_pd(_mm256_loadu_pd(xs + k), vx);
+        __m256d dy = _mm256_sub_pd(_mm256_loadu_pd(ys + k), vy);
+        __m256d d2 = _mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy));
+        __m128 d = _mm_sqrt_ps(_mm256_cvtpd_ps(d2));
+        _mm256_storeu_pd(out + k, _mm256_cvtps_pd(d));
+    }
+
+    distance_row_scalar(xs + k, ys + k, x, y, len - k, out + k);
+}
+
+// explicit rounding keeps the compiler from fusing into an fma, which would change the rounding of the scalar path
+__attribute__((target("avx512f")))
+static void distance_row_avx512(const double* xs, const double* ys, double x, double y, int len, double* out){
+    __m512d vx = _mm512_set1_pd(x);
+    __m512d vy = _mm512_set1_pd(y);
+
+    int k = 0;
+    for(; k + 8 <= len; k += 8){
+        __m512d dx = _mm512_sub_pd(_mm512_loadu_pd(xs + k), vx);
+        __m512d dy = _mm512_sub_pd(_mm512_loadu_pd(ys + k), vy);
+        __m512d d2 = _mm512_add_round_pd(_mm512_mul_round_pd(dx, dx, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+                                         _mm512_mul_round_pd(dy, dy, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC),
+                                         _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        __m256 d = _mm256_sqrt_ps(_mm512_cvtpd_ps(d2));
+        _mm512_storeu_pd(out + k, _mm512_cvtps_pd(d));
+    }
+
+    distance_row_scalar(xs + k, ys + k, x, y, len - k, out + k);
+}
+#endif
+
+void simd_distance_row(const double* xs, const double* ys, double x, double y, int len, double* out){
+    switch(simd_detect()){
+#ifdef SIMD_X86
+        case SIMD_AVX512:
+            distance_row_avx512(xs, ys, x, y, len, out);
+            return;
+        case SIMD_AVX2:
+            distance_row_avx2(xs, ys, x, y, len, out);
+            return;
+#endif
+        default:
+            distance_row_scalar(xs, ys, x, y, len, out);
+            return;
+    }
+}
+
+//================================================================================
+// 2OPT
+//================================================================================
+
+static int two_opt_row_scalar(const double* costs, int n, const int* succ, int a, int b_begin, double* best){
+    int succ_a = succ[a];
+    double cost_a = costs[(size_t)a * n + succ_a];
+    const double* row_a = costs + (size_t)a * n;
+    const double* row_succ_a = costs + (size_t)succ_a * n;
+
+    int best_b = -1;
+    for(int b=b_begin; b<n; b++){
+        int succ_b = succ[b];
+        if(succ_a == succ_b || a == succ_b || b == succ_a){
+            continue;
+        }
+
+        double current_cost = cost_a + costs[(size_t)b * n + succ_b];
+        double swapped_cost = row_a[b] + row_succ_a[succ_b];
+        double delta = swapped_cost - current_cost;
+        if(delta < *best){
+            *best = delta;
+            best_b = b;
+        }
+    }
+
+    return best_b;
+}
+
+/**
+ * @brief Merges the per-lane minima: smallest delta below *best, then smallest b
+ */
+static int two_opt_reduce(const double* lane_delta, const long long* lane_b, int lanes, double* best){
+    int best_b = -1;
+    for(int l=0; l<lanes; l++){
+        if(lane_b[l] == -1){
+            continue;
+        }
+        if(lane_delta[l] < *best || (lane_delta[l] == *best && best_b != -1 && lane_b[l] < best_b)){
+            *best = lane_delta[l];
+            best_b = (int) lane_b[l];
+        }
+    }
+    return best_b;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static int two_opt_row_avx2(const double* costs, int n, const int* succ, int a, int b_begin, double* best){
+    int succ_a = succ[a];
+    const double* row_a = costs + (size_t)a * n;
+
+    __m256d vcost_a = _mm256_set1_pd(costs[(size_t)a * n + succ_a]);
+    __m128i va = _mm_set1_epi32(a);
+    __m128i vsucc_a = _mm_set1_epi32(succ_a);
+    __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    __m256i vn = _mm256_set1_epi64x(n);
+    __m256i vrow_succ_a = _mm256_set1_epi64x((long long)succ_a * n);
+    __m256d skipped = _mm256_set1_pd(INFINITY);
+
+    // each lane keeps its own minimum, a strict comparison keeps the first b among ties
+    __m256d vbest = _mm256_set1_pd(*best);
+    __m256i vbest_b = _mm256_set1_epi64x(-1);
+
+    int b = b_begin;
+    for(; b + 4 <= n; b += 4){
+        __m128i vb = _mm_add_epi32(_mm_set1_epi32(b), lane);
+        __m128i vsucc_b = _mm_loadu_si128((const __m128i*)(succ + b));
+        __m128i skip = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi32(vsucc_b, vsucc_a), _mm_cmpeq_epi32(vsucc_b, va)),
+                                    _mm_cmpeq_epi32(vb, vsucc_a));
+
+        __m256i b64 = _mm256_cvtepi32_epi64(vb);
+        __m256i succ_b64 = _mm256_cvtepi32_epi64(vsucc_b);
+        __m256d cost_b = _mm256_i64gather_pd(costs, _mm256_add_epi64(_mm256_mul_epu32(b64, vn), succ_b64), 8);
+        __m256d cost_succ = _mm256_i64gather_pd(costs, _mm256_add_epi64(vrow_succ_a, succ_b64), 8);
+
+        __m256d current_cost = _mm256_add_pd(vcost_a, cost_b);
+        __m256d swapped_cost = _mm256_add_pd(_mm256_loadu_pd(row_a + b), cost_succ);
+        __m256d delta = _mm256_sub_pd(swapped_cost, current_cost);
+        delta = _mm256_blendv_pd(delta, skipped, _mm256_castsi256_pd(_mm256_cvtepi32_epi64(skip)));
+
+        __m256d lt = _mm256_cmp_pd(delta, vbest, _CMP_LT_OQ);
+        vbest = _mm256_blendv_pd(vbest, delta, lt);
+        vbest_b = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(vbest_b), _mm256_castsi256_pd(b64), lt));
+    }
+
+    double lane_delta[4];
+    long long lane_b[4];
+    _mm256_storeu_pd(lane_delta, vbest);
+    _mm256_storeu_si256((__m256i*) lane_b, vbest_b);
+    int best_b = two_opt_reduce(lane_delta, lane_b, 4, best);
+
+    // remaining b are larger, they win only with a strictly smaller delta
+    int tail_b = two_opt_row_scalar(costs, n, succ, a, b, best);
+    return tail_b != -1 ? tail_b : best_b;
+}
+
+__attribute__((target("avx512f")))
+static int two_opt_row_avx512(const double* costs, int n, const int* succ, int a, int b_begin, double* best){
+    int succ_a = succ[a];
+    const double* row_a = costs + (size_t)a * n;
+
+    __m512d vcost_a = _mm512_set1_pd(costs[(size_t)a * n + succ_a]);
+    __m512i va = _mm512_set1_epi64(a);
+    __m512i vsucc_a = _mm512_set1_epi64(succ_a);
+    __m512i lane = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    __m512i vn = _mm512_set1_epi64(n);
+    __m512i vrow_succ_a = _mm512_set1_epi64((long long)succ_a * n);
+
+    __m512d vbest = _mm512_set1_pd(*best);
+    __m512i vbest_b = _mm512_set1_epi64(-1);
+
+    int b = b_begin;
+    for(; b + 8 <= n; b += 8){
+        __m512i b64 = _mm512_add_epi64(_mm512_set1_epi64(b), lane);
+        __m512i succ_b64 = _mm512_cvtepi32_epi64(_mm256_loadu_si256((const __m256i*)(succ + b)));
+        __mmask8 skip = _mm512_cmpeq_epi64_mask(succ_b64, vsucc_a) | _mm512_cmpeq_epi64_mask(succ_b64, va) |
+                        _mm512_cmpeq_epi64_mask(b64, vsucc_a);
+
+        __m512d cost_b = _mm512_i64gather_pd(_mm512_add_epi64(_mm512_mul_epu32(b64, vn), succ_b64), costs, 8);
+        __m512d cost_succ = _mm512_i64gather_pd(_mm512_add_epi64(vrow_succ_a, succ_b64), costs, 8);
+
+        __m512d current_cost = _mm512_add_pd(vcost_a, cost_b);
+        __m512d swapped_cost = _mm512_add_pd(_mm512_loadu_pd(row_a + b), cost_succ);
+        __m512d delta = _mm512_sub_pd(swapped_cost, current_cost);
+
+        __mmask8 lt = _mm512_mask_cmp_pd_mask((__mmask8) ~skip, delta, vbest, _CMP_LT_OQ);
+        vbest = _mm512_mask_mov_pd(vbest, lt, delta);
+        vbest_b = _mm512_mask_mov_epi64(vbest_b, lt, b64);
+    }
+
+    double lane_delta[8];
+    long long lane_b[8];
+    _mm512_storeu_pd(lane_delta, vbest);
+    _mm512_storeu_si512(lane_b, vbest_b);
+    int best_b = two_opt_reduce(lane_delta, lane_b, 8, best);
+
+    int tail_b = two_opt_row_scalar(costs, n, succ, a, b, best);
+    return tail_b != -1 ? tail_b : best_b;
+}
+#endif
+
+int simd_2opt_row(const double* costs, int n, const int* succ, int a, int b_begin, double* best){
+    switch(simd_detect()){
+#ifdef SIMD_X86
+        case SIMD_AVX512:
+            return two_opt_row_avx512(costs, n, succ, a, b_begin, best);
+        case SIMD_AVX2:
+            return two_opt_row_avx2(costs, n, succ, a, b_begin, best);
+#endif
+        default:
+            return two_opt_row_scalar(costs, n, succ, a, b_begin, best);
+    }
+}
+
+//================================================================================
+// NEAREST UNVISITED
+//================================================================================
+
+#define ARGMIN_SPARSE_BITS 8    // words with at most these free nodes are scanned without vectors
+
+/**
+ * @brief Scalar scan of the unvisited nodes of one bitmap word, starting at node base
+ */
+static inline void argmin_word_scalar(const double* row, uint64_t free_bits, int base, int* best, double* min){
+    while(free_bits){
+        int k = base + __builtin_ctzll(free_bits);
+        free_bits &= free_bits - 1;
+        if(row[k] >= 0 && row[k] < *min){
+            *min = row[k];
+            *best = k;
+        }
+    }
+}
+
+/**
+ * @brief Unvisited bits of word w, with the bits past n cleared
+ */
+static inline uint64_t argmin_free_bits(const uint64_t* visited, int w, int n){
+    uint64_t free_bits = ~visited[w];
+    int left = n - w * 64;
+    if(left < 64){
+        free_bits &= (1ULL << left) - 1;
+    }
+    return free_bits;
+}
+
+static int argmin_unvisited_scalar(const double* row, const uint64_t* visited, int n, double* min){
+    int best = -1;
+    *min = __DBL_MAX__;
+
+    int words = (n + 63) / 64;
+    for(int w=0; w<words; w++){
+        argmin_word_scalar(row, argmin_free_bits(visited, w, n), w * 64, &best, min);
+    }
+
+    return best;
+}
+
+/**
+ * @brief Merges the per-lane minima: smallest cost, then smallest index
+ */
+static int argmin_reduce(const double* lane_min, const long long* lane_idx, int lanes, int best, double* min){
+    for(int l=0; l<lanes; l++){
+        if(lane_idx[l] == -1){
+            continue;
+        }
+        if(lane_min[l] < *min || (lane_min[l] == *min && (best == -1 || lane_idx[l] < best))){
+            *min = lane_min[l];
+            best = (int) lane_idx[l];
+        }
+    }
+    return best;
+}
+
+#ifdef SIMD_X86
+__attribute__((target("avx2")))
+static int argmin_unvisited_avx2(const double* row, const uint64_t* visited, int n, double* min){
+    const __m256i bit = _mm256_setr_epi64x(1, 2, 4, 8);
+    const __m256i lane = _mm256_setr_epi64x(0, 1, 2, 3);
+    const __m256d zero = _mm256_setzero_pd();
+
+    // four independent accumulators, so that consecutive vectors do not wait on each other
+    __m256d vmin[4];
+    __m256i vidx[4];
+    for(int j=0; j<4; j++){
+        vmin[j] = _mm256_set1_pd(__DBL_MAX__);
+        vidx[j] = _mm256_set1_epi64x(-1);
+    }
+
+    int best = -1;
+    *min = __DBL_MAX__;
+
+    int full_words = n / 64;
+    for(int w=0; w<full_words; w++){
+        uint64_t free_bits = ~visited[w];
+        if(free_bits == 0){
+            continue;
+        }
+
+        // few free nodes are cheaper one by one, the lanes are merged with them at the end
+        if(__builtin_popcountll(free_bits) <= ARGMIN_SPARSE_BITS){
+            argmin_word_scalar(row, free_bits, w * 64, &best, min);
+            continue;
+        }
+
+        for(int q=0; q<16; q+=4){
+            for(int j=0; j<4; j++){
+                int k = w * 64 + (q + j) * 4;
+                long long nibble = (long long)((free_bits >> ((q + j) * 4)) & 0xF);
+                __m256i is_free = _mm256_cmpeq_epi64(_mm256_and_si256(_mm256_set1_epi64x(nibble), bit), bit);
+                __m256d c = _mm256_loadu_pd(row + k);
+                __m256d lt = _mm256_and_pd(_mm256_cmp_pd(c, vmin[j], _CMP_LT_OQ), _mm256_cmp_pd(c, zero, _CMP_GE_OQ));
+                lt = _mm256_and_pd(lt, _mm256_castsi256_pd(is_free));
+
+                vmin[j] = _mm256_blendv_pd(vmin[j], c, lt);
+                __m256i idx = _mm256_add_epi64(_mm256_set1_epi64x(k), lane);
+                vidx[j] = _mm256_castpd_si256(_mm256_blendv_pd(_mm256_castsi256_pd(vidx[j]), _mm256_castsi256_pd(idx), lt));
+            }
+        }
+    }
+
+    double lane_min[16];
+    long long lane_idx[16];
+    for(int j=0; j<4; j++){
+        _mm256_storeu_pd(lane_min + 4 * j, vmin[j]);
+        _mm256_storeu_si256((__m256i*)(lane_idx + 4 * j), vidx[j]);
+    }
+    best = argmin_reduce(lane_min, lane_idx, 16, best, min);
+
+    // the last partial word holds larger indices, it wins only with a strictly smaller cost
+    if(full_words * 64 < n){
+        argmin_word_scalar(row, argmin_free_bits(visited, full_words, n), full_words * 64, &best, min);
+    }
+
+    return best;
+}
+
+__attribute__((target("avx512f")))
+static int argmin_unvisited_avx512(const double* row, const uint64_t* visited, int n, double* min){
+    const __m512i lane = _mm512_setr_epi64(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m512d zero = _mm512_setzero_pd();
+
+    __m512d vmin = _mm512_set1_pd(__DBL_MAX__);
+    __m512i vidx = _mm512_set1_epi64(-1);
+
+    int best = -1;
+    *min = __DBL_MAX__;
+
+    int full_words = n / 64;
+    for(int w=0; w<full_words; w++){
+        uint64_t free_bits = ~visited[w];
+        if(free_bits == 0){
+            continue;
+        }
+
+        // few free nodes are cheaper one by one, the lanes are merged with them at the end
+        if(__builtin_popcountll(free_bits) <= ARGMIN_SPARSE_BITS){
+            argmin_word_scalar(row, free_bits, w * 64, &best, min);
+            continue;
+        }
+
+        for(int q=0; q<8; q++){
+            __mmask8 is_free = (__mmask8)(free_bits >> (q * 8));
+            if(is_free == 0){
+                continue;
+            }
+
+            int k = w * 64 + q * 8;
+            __m512d c = _mm512_loadu_pd(row + k);
+            __mmask8 lt = _mm512_mask_cmp_pd_mask(is_free, c, vmin, _CMP_LT_OQ);
+            lt = _mm512_mask_cmp_pd_mask(lt, c, zero, _CMP_GE_OQ);
+
+            vmin = _mm512_mask_mov_pd(vmin, lt, c);
+            vidx = _mm512_mask_mov_epi64(vidx, lt, _mm512_add_epi64(_mm512_set1_epi64(k), lane));
+        }
+    }
+
+    double lane_min[8];
+    long long lane_idx[8];
+    _mm512_storeu_pd(lane_min, vmin);
+    _mm512_storeu_si512(lane_idx, vidx);
+    best = argmin_reduce(lane_min, lane_idx, 8, best, min);
+
+    if(full_words * 64 < n){
+        argmin_word_scalar(row, argmin_free_bits(visited, full_words, n), full_words * 64, &best, min);
+    }
+
+    return best;
+}
+#endif
+
+int simd_argmin_unvisited(const double* row, const uint64_t* visited, int n, double* min){
+    switch(simd_detect()){
+#ifdef SIMD_X86
+        case SIMD_AVX512:
+            return argmin_unvisited_avx512(row, visited, n, min);
+        case SIMD_AVX2:
+            return argmin_unvisited_avx2(row, visited, n, min);
+#endif
+        default:
+            return argmin_unvisited_scalar(row, visited, n, min);
+    }
+}
@@ -0,0 +1,81 @@
+#ifndef SIMD_H_
+#define SIMD_H_
+
+/**
+ * @file simd.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Vectorized kernels with runtime CPU dispatch and scalar fallback
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <stdint.h>
+
+#include "errors.h"
+
+/**
+ * @brief Instruction sets the kernels are compiled for
+ * 
+ */
+typedef enum {
+    SIMD_SCALAR = 0,
+    SIMD_AVX2 = 1,
+    SIMD_AVX512 = 2
+} simd_level;
+
+/**
+ * @brief Best instruction set supported by the running CPU, detected once
+ * 
+ * @return simd_level 
+ */
+simd_level simd_detect(void);
+
+/**
+ * @brief Euclidean distances from (x, y) to the points (xs[k], ys[k]), k < len.
+ * Rounded through float like sqrtf, so results are identical on every level
+ * 
+ * @param xs x coordinates
+ * @param ys y coordinates
+ * @param x x coordinate of the source
+ * @param y y coordinate of the source
+ * @param len number of points
+ * @param out output distances
+ */
+void simd_distance_row(const double* xs, const double* ys, double x, double y, int len, double* out);
+
+
+/**
+ * @brief Best 2opt move (a, b) for a fixed a and b from b_begin to n - 1 on the dense n x n cost matrix:
+ * delta = costs[a][b] + costs[succ_a][succ[b]] - costs[a][succ_a] - costs[b][succ[b]].
+ * Moves with succ[b] == succ_a, succ[b] == a or b == succ_a are skipped. Costs of b are
+ * gathered, so deltas are the same on every level
+ * 
+ * @param costs dense cost matrix
+ * @param n number of nodes
+ * @param succ successor of each node
+ * @param a first node
+ * @param b_begin first b
+ * @param best only deltas < *best are considered, updated with the delta of the result
+ * @return int the first b with the smallest delta, -1 if none is below *best
+ */
+int simd_2opt_row(const double* costs, int n, const int* succ, int a, int b_begin, double* best);
+
+
+/**
+ * @brief Cheapest entry of a cost row among the nodes not marked in a visited bitmap, first one
+ * among ties. Node k is visited if bit k % 64 of visited[k / 64] is set; words made only of
+ * visited nodes are skipped, so late steps of a greedy tour cost O(n / 64). Negative costs
+ * are missing edges
+ * 
+ * @param row costs from the current node
+ * @param visited bitmap of (n + 63) / 64 words
+ * @param n length of the row
+ * @param min cost of the result
+ * @return int index of the cheapest unvisited node, -1 if all are visited
+ */
+int simd_argmin_unvisited(const double* row, const uint64_t* visited, int n, double* min);
+
+#endif
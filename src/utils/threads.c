@@ -0,0 +1,72 @@
+#include "threads.h"
+
+#include <unistd.h>
+
+typedef struct {
+    threads_task task;
+    void* ctx;
+    int thread_id;
+    int nthreads;
+} threads_worker;
+
+static void* threads_entry(void* arg){
+    threads_worker* w = (threads_worker*) arg;
+    w->task(w->ctx, w->thread_id, w->nthreads);
+    return NULL;
+}
+
+int threads_available(void){
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
+
+ERROR_CODE threads_run(int nthreads, threads_task task, void* ctx){
+    if(nthreads <= 1){
+        task(ctx, 0, 1);
+        return OK;
+    }
+
+    pthread_t* handles = (pthread_t*) calloc(nthreads, sizeof(pthread_t));
+    bool* spawned = (bool*) calloc(nthreads, sizeof(bool));
+    threads_worker* workers = (threads_worker*) calloc(nthreads, sizeof(threads_worker));
+    if(handles == NULL || spawned == NULL || workers == NULL){
+        free(handles);
+        free(spawned);
+        free(workers);
+        log_warn("cannot allocate workers, running on a single thread");
+        for(int t=0; t<nthreads; t++){
+            task(ctx, t, nthreads);
+        }
+        return OK;
+    }
+
+    for(int t=0; t<nthreads; t++){
+        workers[t].task = task;
+        workers[t].ctx = ctx;
+        workers[t].thread_id = t;
+        workers[t].nthreads = nthreads;
+    }
+
+    for(int t=1; t<nthreads; t++){
+        spawned[t] = pthread_create(&handles[t], NULL, threads_entry, &workers[t]) == 0;
+        if(!spawned[t]){
+            log_warn("cannot spawn thread %d, running it on the calling thread", t);
+        }
+    }
+
+    task(ctx, 0, nthreads);
+
+    for(int t=1; t<nthreads; t++){
+        if(spawned[t]){
+            pthread_join(handles[t], NULL);
+        }else{
+            task(ctx, t, nthreads);
+        }
+    }
+
+    free(handles);
+    free(spawned);
+    free(workers);
+
+    return OK;
+}
@@ -0,0 +1,44 @@
+#ifndef THREADS_H_
+#define THREADS_H_
+
+/**
+ * @file threads.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Minimal fork-join helpers on top of pthreads
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include <pthread.h>
+
+#include "errors.h"
+
+/**
+ * @brief Body executed by every worker, thread_id goes from 0 to nthreads-1
+ * 
+ */
+typedef void (*threads_task)(void* ctx, int thread_id, int nthreads);
+
+/**
+ * @brief Number of online processors, at least 1
+ * 
+ * @return int 
+ */
+int threads_available(void);
+
+/**
+ * @brief Runs task on nthreads workers and waits for all of them. The calling thread
+ * runs worker 0; if a thread cannot be spawned its worker runs on the calling thread,
+ * so static partitions by thread_id are always fully processed
+ * 
+ * @param nthreads number of workers
+ * @param task body of the workers
+ * @param ctx shared context passed to every worker
+ * @return ERROR_CODE 
+ */
+ERROR_CODE threads_run(int nthreads, threads_task task, void* ctx);
+
+#endif
@@ -0,0 +1,443 @@
+#include "tour.h"
+
+#include <math.h>
+#include <string.h>
+
+//================================================================================
+// TWO-LEVEL LIST UTILS
+//================================================================================
+
+static inline int* tour_slot(const tour* t, int s){
+    return t->node_pool + (size_t)s * t->group;
+}
+
+/**
+ * @brief Index of node a along its segment, in tour order
+ */
+static inline int tour_oriented(const tour* t, int a){
+    const tour_segment* s = &t->segments[t->seg[a]];
+    return s->reversed ? s->size - 1 - t->idx[a] : t->idx[a];
+}
+
+/**
+ * @brief Node at index o along segment s, in tour order
+ */
+static inline int tour_node_at(const tour* t, int s, int o){
+    const tour_segment* sg = &t->segments[s];
+    return tour_slot(t, s)[sg->reversed ? sg->size - 1 - o : o];
+}
+
+static inline long long tour_key(const tour* t, int a){
+    if(t->type == TOUR_ARRAY){
+        return t->pos[a];
+    }
+    return ((long long) t->segments[t->seg[a]].rank << 32) | tour_oriented(t, a);
+}
+
+/**
+ * @brief Clears the reversal bit of a segment by reversing its storage
+ */
+static void tour_normalize(tour* t, int s){
+    tour_segment* sg = &t->segments[s];
+    if(!sg->reversed){
+        return;
+    }
+
+    int* nodes = tour_slot(t, s);
+    for(int i=0, j=sg->size-1; i<j; i++, j--){
+        int tmp = nodes[i];
+        nodes[i] = nodes[j];
+        nodes[j] = tmp;
+    }
+    for(int i=0; i<sg->size; i++){
+        t->idx[nodes[i]] = i;
+    }
+    sg->reversed = false;
+}
+
+static void tour_set_ranks(tour* t, int from, int to){
+    for(int r=from; r<to; r++){
+        t->segments[t->segment_order[r]].rank = r;
+    }
+}
+
+/**
+ * @brief Loads the tour again from its successors, in full segments
+ */
+static void tour_rebuild(tour* t){
+    tour_from_successors(t, tour_successors(t));
+}
+
+/**
+ * @brief Splits segment s before index o (in tour order), the tail becomes a new segment.
+ * Without free segments the list is rebuilt and nothing is split
+ * 
+ * @return false if the list was rebuilt, segments and indices of the nodes have changed
+ */
+static bool tour_split(tour* t, int s, int o){
+    if(t->nfree == 0){
+        tour_rebuild(t);
+        return false;
+    }
+
+    tour_normalize(t, s);
+
+    int n = t->free_segments[--t->nfree];
+    tour_segment* sg = &t->segments[s];
+    tour_segment* ng = &t->segments[n];
+
+    int* from = tour_slot(t, s);
+    int* to = tour_slot(t, n);
+    ng->size = sg->size - o;
+    ng->reversed = false;
+    for(int i=0; i<ng->size; i++){
+        to[i] = from[o + i];
+        t->seg[to[i]] = n;
+        t->idx[to[i]] = i;
+    }
+    sg->size = o;
+
+    // insert after s
+    int r = sg->rank + 1;
+    memmove(t->segment_order + r + 1, t->segment_order + r, (t->nsegments - r) * sizeof(int));
+    t->segment_order[r] = n;
+    t->nsegments++;
+    tour_set_ranks(t, r, t->nsegments);
+
+    return true;
+}
+
+/**
+ * @brief Appends segment b to segment a when they fit in one, b must follow a
+ */
+static void tour_try_merge(tour* t, int a, int b){
+    tour_segment* sa = &t->segments[a];
+    tour_segment* sb = &t->segments[b];
+    if(a == b || t->nsegments < 2 || sa->size + sb->size > t->group){
+        return;
+    }
+
+    tour_normalize(t, a);
+    tour_normalize(t, b);
+
+    int* to = tour_slot(t, a);
+    int* from = tour_slot(t, b);
+    for(int i=0; i<sb->size; i++){
+        to[sa->size + i] = from[i];
+        t->seg[from[i]] = a;
+        t->idx[from[i]] = sa->size + i;
+    }
+    sa->size += sb->size;
+
+    int r = sb->rank;
+    memmove(t->segment_order + r, t->segment_order + r + 1, (t->nsegments - r - 1) * sizeof(int));
+    t->nsegments--;
+    tour_set_ranks(t, r, t->nsegments);
+
+    sb->size = 0;
+    sb->rank = -1;
+    t->free_segments[t->nfree++] = b;
+}
+
+static inline int tour_segment_after(const tour* t, int s){
+    return t->segment_order[(t->segments[s].rank + 1) % t->nsegments];
+}
+
+static inline int tour_segment_before(const tour* t, int s){
+    return t->segment_order[(t->segments[s].rank - 1 + t->nsegments) % t->nsegments];
+}
+
+/**
+ * @brief Reverses the path going forward from a to b in the two-level list
+ */
+static void tour_reverse_two_level(tour* t, int a, int b){
+    int before = tour_prev(t, a);
+    int after = tour_next(t, b);
+
+    // a rebuild in the second split would undo the first one, so both must fit in the pool
+    if(t->nfree < 2){
+        tour_rebuild(t);
+    }
+
+    // make the path a sequence of whole segments
+    int oa = tour_oriented(t, a);
+    if(oa > 0){
+        tour_split(t, t->seg[a], oa);
+    }
+    int ob = tour_oriented(t, b);
+    if(ob < t->segments[t->seg[b]].size - 1){
+        tour_split(t, t->seg[b], ob + 1);
+    }
+
+    // reverse the order of the segments and flip their bits
+    int r1 = t->segments[t->seg[a]].rank;
+    int r2 = t->segments[t->seg[b]].rank;
+    int len = (r2 - r1 + t->nsegments) % t->nsegments + 1;
+    for(int k=0; k<len; k++){
+        int r = (r1 + k) % t->nsegments;
+        t->segments[t->segment_order[r]].reversed ^= true;
+    }
+    for(int k=0; k<len/2; k++){
+        int ri = (r1 + k) % t->nsegments;
+        int rj = (r2 - k + t->nsegments) % t->nsegments;
+        int tmp = t->segment_order[ri];
+        t->segment_order[ri] = t->segment_order[rj];
+        t->segment_order[rj] = tmp;
+        t->segments[t->segment_order[ri]].rank = ri;
+        t->segments[t->segment_order[rj]].rank = rj;
+    }
+
+    // the splits shrank the pieces of the segments of a and b: merge at every boundary they
+    // touch, outside and inside the reversed path, so that no two adjacent segments fit in
+    // one and their number stays O(sqrt(n))
+    tour_try_merge(t, tour_segment_before(t, t->seg[before]), t->seg[before]);
+    tour_try_merge(t, t->seg[before], t->seg[b]);
+    tour_try_merge(t, t->seg[b], tour_segment_after(t, t->seg[b]));
+    tour_try_merge(t, tour_segment_before(t, t->seg[a]), t->seg[a]);
+    tour_try_merge(t, t->seg[a], t->seg[after]);
+    tour_try_merge(t, t->seg[after], tour_segment_after(t, t->seg[after]));
+}
+
+//================================================================================
+// ARRAY UTILS
+//================================================================================
+
+static void tour_reverse_array(tour* t, int a, int b){
+    int n = t->nnodes;
+    int i = t->pos[a];
+    int j = t->pos[b];
+    int len = (j - i + n) % n + 1;
+
+    for(int k=0; k<len/2; k++){
+        int pi = (i + k) % n;
+        int pj = (j - k + n) % n;
+        int tmp = t->order[pi];
+        t->order[pi] = t->order[pj];
+        t->order[pj] = tmp;
+        t->pos[t->order[pi]] = pi;
+        t->pos[t->order[pj]] = pj;
+    }
+}
+
+//================================================================================
+// TOUR
+//================================================================================
+
+ERROR_CODE tour_init(tour* t, int nnodes){
+    return tour_init_type(t, nnodes, nnodes < TOUR_TWO_LEVEL_THRESHOLD ? TOUR_ARRAY : TOUR_TWO_LEVEL);
+}
+
+ERROR_CODE tour_init_type(tour* t, int nnodes, tour_type type){
+    memset(t, 0, sizeof(tour));
+    t->type = type;
+    t->nnodes = nnodes;
+    t->succ = (int*) malloc(nnodes * sizeof(int));
+    t->succ_valid = false;
+
+    if(type == TOUR_ARRAY){
+        t->order = (int*) malloc(nnodes * sizeof(int));
+        t->pos = (int*) malloc(nnodes * sizeof(int));
+        if(t->succ == NULL || t->order == NULL || t->pos == NULL){
+            tour_free(t);
+            return RESOURCE_EXHAUSTED;
+        }
+        return OK;
+    }
+
+    t->group = (int) sqrt((double) nnodes);
+    if(t->group < 1){
+        t->group = 1;
+    }
+    // after every move adjacent segments never fit together in one, so they are at most
+    // 2n/group + 1, plus the two splits of a move before merging
+    t->max_segments = 2 * (nnodes / t->group) + 8;
+
+    t->segments = (tour_segment*) calloc(t->max_segments, sizeof(tour_segment));
+    t->segment_order = (int*) malloc(t->max_segments * sizeof(int));
+    t->free_segments = (int*) malloc(t->max_segments * sizeof(int));
+    t->node_pool = (int*) malloc((size_t)t->max_segments * t->group * sizeof(int));
+    t->seg = (int*) malloc(nnodes * sizeof(int));
+    t->idx = (int*) malloc(nnodes * sizeof(int));
+    if(t->succ == NULL || t->segments == NULL || t->segment_order == NULL || t->free_segments == NULL ||
+       t->node_pool == NULL || t->seg == NULL || t->idx == NULL){
+        tour_free(t);
+        return RESOURCE_EXHAUSTED;
+    }
+
+    return OK;
+}
+
+void tour_from_successors(tour* t, const int* succ){
+    int n = t->nnodes;
+
+    if(t->type == TOUR_ARRAY){
+        int node = 0;
+        for(int p=0; p<n; p++){
+            t->order[p] = node;
+            t->pos[node] = p;
+            node = succ[node];
+        }
+    }else{
+        t->nsegments = 0;
+        t->nfree = 0;
+        for(int s=t->max_segments-1; s>=0; s--){
+            t->segments[s].size = 0;
+            t->segments[s].rank = -1;
+            t->free_segments[t->nfree++] = s;
+        }
+
+        int node = 0;
+        for(int p=0; p<n; p++){
+            if(p % t->group == 0){
+                int s = t->free_segments[--t->nfree];
+                t->segments[s].reversed = false;
+                t->segments[s].rank = t->nsegments;
+                t->segment_order[t->nsegments++] = s;
+            }
+            int s = t->segment_order[t->nsegments - 1];
+            tour_slot(t, s)[t->segments[s].size] = node;
+            t->seg[node] = s;
+            t->idx[node] = t->segments[s].size++;
+            node = succ[node];
+        }
+    }
+
+    if(succ != t->succ){
+        memcpy(t->succ, succ, n * sizeof(int));
+    }
+    t->succ_valid = true;
+}
+
+void tour_to_successors(tour* t, int* succ){
+    memcpy(succ, tour_successors(t), t->nnodes * sizeof(int));
+}
+
+const int* tour_successors(tour* t){
+    if(!t->succ_valid){
+        if(t->type == TOUR_ARRAY){
+            for(int p=0; p<t->nnodes; p++){
+                t->succ[t->order[p]] = t->order[(p + 1) % t->nnodes];
+            }
+        }else{
+            // walk the segments in order, each in its own direction
+            int prev = -1, first = -1;
+            for(int r=0; r<t->nsegments; r++){
+                int s = t->segment_order[r];
+                for(int o=0; o<t->segments[s].size; o++){
+                    int node = tour_node_at(t, s, o);
+                    if(prev == -1){
+                        first = node;
+                    }else{
+                        t->succ[prev] = node;
+                    }
+                    prev = node;
+                }
+            }
+            t->succ[prev] = first;
+        }
+        t->succ_valid = true;
+    }
+
+    return t->succ;
+}
+
+int tour_next(const tour* t, int a){
+    if(t->type == TOUR_ARRAY){
+        int p = t->pos[a] + 1;
+        return t->order[p == t->nnodes ? 0 : p];
+    }
+
+    int s = t->seg[a];
+    int o = tour_oriented(t, a);
+    if(o + 1 < t->segments[s].size){
+        return tour_node_at(t, s, o + 1);
+    }
+    return tour_node_at(t, tour_segment_after(t, s), 0);
+}
+
+int tour_prev(const tour* t, int a){
+    if(t->type == TOUR_ARRAY){
+        int p = t->pos[a];
+        return t->order[p == 0 ? t->nnodes - 1 : p - 1];
+    }
+
+    int s = t->seg[a];
+    int o = tour_oriented(t, a);
+    if(o > 0){
+        return tour_node_at(t, s, o - 1);
+    }
+    int b = tour_segment_before(t, s);
+    return tour_node_at(t, b, t->segments[b].size - 1);
+}
+
+bool tour_between(const tour* t, int a, int b, int c){
+    long long pa = tour_key(t, a);
+    long long pb = tour_key(t, b);
+    long long pc = tour_key(t, c);
+
+    if(pa <= pc){
+        return pa <= pb && pb <= pc;
+    }
+    return pb >= pa || pb <= pc;
+}
+
+bool tour_sequence(const tour* t, const int* nodes, int count){
+    for(int i=1; i+1<count; i++){
+        if(!tour_between(t, nodes[0], nodes[i], nodes[i + 1])){
+            return false;
+        }
+    }
+    return true;
+}
+
+void tour_2opt_move(tour* t, int a, int b){
+    int succ_a = tour_next(t, a);
+    int succ_b = tour_next(t, b);
+    if(a == b || succ_a == b || succ_b == a){
+        return;
+    }
+
+    // reversing succ_a..b or succ_b..a gives the same cycle, pick the shorter
+    bool inner;
+    if(t->type == TOUR_ARRAY){
+        int n = t->nnodes;
+        int len = (t->pos[b] - t->pos[succ_a] + n) % n + 1;
+        inner = 2 * len <= n;
+    }else{
+        int ns = t->nsegments;
+        int len = (t->segments[t->seg[b]].rank - t->segments[t->seg[succ_a]].rank + ns) % ns;
+        inner = 2 * len <= ns;
+    }
+
+    int from = inner ? succ_a : succ_b;
+    int to = inner ? b : a;
+    if(t->type == TOUR_ARRAY){
+        tour_reverse_array(t, from, to);
+    }else{
+        tour_reverse_two_level(t, from, to);
+    }
+
+    t->succ_valid = false;
+}
+
+void tour_swap_edges(tour* t, int a, int succ_a, int b, int succ_b){
+    if(tour_next(t, a) == succ_a){
+        tour_2opt_move(t, a, b);
+    }else{
+        // the tour runs the other way: (succ_a, a) and (succ_b, b) are the forward edges
+        tour_2opt_move(t, succ_a, succ_b);
+    }
+}
+
+void tour_free(tour* t){
+    free(t->order);
+    free(t->pos);
+    free(t->segments);
+    free(t->segment_order);
+    free(t->free_segments);
+    free(t->node_pool);
+    free(t->seg);
+    free(t->idx);
+    free(t->succ);
+    memset(t, 0, sizeof(tour));
+}
@@ -0,0 +1,182 @@
+#ifndef TOUR_H_
+#define TOUR_H_
+
+/**
+ * @file tour.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Order-based tour representation with fast segment reversal
+ * @version 0.1
+ * @date 2026-10-18
+ * 
+ * @copyright Copyright (c) 2024
+ * 
+ */
+
+#include "errors.h"
+
+#define TOUR_TWO_LEVEL_THRESHOLD 1000  // from this number of nodes the two-level list is used
+
+/**
+ * @brief Backing structure of a tour
+ * 
+ */
+typedef enum {
+    TOUR_ARRAY = 0,             // array with positions, reversal in O(n)
+    TOUR_TWO_LEVEL = 1          // two-level doubly-linked list, reversal in O(sqrt(n))
+} tour_type;
+
+/**
+ * @brief Segment of the two-level list. Nodes are stored in a slot of
+ * tour.node_pool and visited backwards when the segment is reversed
+ * 
+ */
+typedef struct {
+    int size;                   // nodes in the segment, 0 if the segment is unused
+    bool reversed;              // reversal bit
+    int rank;                   // position of the segment along the tour
+} tour_segment;
+
+/**
+ * @brief Tour as a cyclic sequence of nodes. The orientation is not fixed:
+ * a move may flip the whole tour, so callers must query next/prev after it
+ * 
+ */
+typedef struct {
+    tour_type type;
+    int nnodes;
+
+    // TOUR_ARRAY
+    int* order;                 // node at each position
+    int* pos;                   // position of each node
+
+    // TOUR_TWO_LEVEL
+    int group;                  // maximum size of a segment, about sqrt(n)
+    int nsegments;              // segments along the tour
+    int max_segments;
+    tour_segment* segments;     // all segments, used or free
+    int* segment_order;         // segment at each rank
+    int* free_segments;         // stack of unused segments
+    int nfree;
+    int* node_pool;             // max_segments slots of group nodes
+    int* seg;                   // segment of each node
+    int* idx;                   // stored index of each node in its segment
+
+    int* succ;                  // successors, rebuilt on demand
+    bool succ_valid;
+} tour;
+
+/**
+ * @brief Allocates a tour, the array for small instances and the two-level list otherwise
+ * 
+ * @param t 
+ * @param nnodes 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tour_init(tour* t, int nnodes);
+
+/**
+ * @brief Allocates a tour with the given backing structure
+ * 
+ * @param t 
+ * @param nnodes 
+ * @param type 
+ * @return ERROR_CODE 
+ */
+ERROR_CODE tour_init_type(tour* t, int nnodes, tour_type type);
+
+/**
+ * @brief Loads the tour described by a successor array, as in tsp_solution.path
+ * 
+ * @param t 
+ * @param succ succ[i] is the node after i
+ */
+void tour_from_successors(tour* t, const int* succ);
+
+/**
+ * @brief Writes the tour as a successor array
+ * 
+ * @param t 
+ * @param succ 
+ */
+void tour_to_successors(tour* t, int* succ);
+
+/**
+ * @brief Successor array of the tour, rebuilt in O(n) only after a move
+ * 
+ * @param t 
+ * @return const int* valid until the next move
+ */
+const int* tour_successors(tour* t);
+
+/**
+ * @brief Node after a
+ * 
+ * @param t 
+ * @param a 
+ * @return int 
+ */
+int tour_next(const tour* t, int a);
+
+/**
+ * @brief Node before a
+ * 
+ * @param t 
+ * @param a 
+ * @return int 
+ */
+int tour_prev(const tour* t, int a);
+
+/**
+ * @brief Whether b lies on the path going forward from a to c, endpoints included
+ * 
+ * @param t 
+ * @param a 
+ * @param b 
+ * @param c 
+ * @return true 
+ * @return false 
+ */
+bool tour_between(const tour* t, int a, int b, int c);
+
+/**
+ * @brief Whether the nodes are met in the given order going forward from nodes[0]
+ * 
+ * @param t 
+ * @param nodes 
+ * @param count 
+ * @return true 
+ * @return false 
+ */
+bool tour_sequence(const tour* t, const int* nodes, int count);
+
+/**
+ * @brief 2-opt move: removes edges (a, next(a)) and (b, next(b)) and adds (a, b) and
+ * (next(a), next(b)), reversing the shorter of the two paths
+ * 
+ * @param t 
+ * @param a 
+ * @param b 
+ */
+void tour_2opt_move(tour* t, int a, int b);
+
+/**
+ * @brief 2-opt move given by the removed edges: removes (a, succ_a) and (b, succ_b) and adds
+ * (a, b) and (succ_a, succ_b). The pairs can be adjacent in either direction, as long as
+ * both have the same one
+ * 
+ * @param t 
+ * @param a 
+ * @param succ_a 
+ * @param b 
+ * @param succ_b 
+ */
+void tour_swap_edges(tour* t, int a, int succ_a, int b, int succ_b);
+
+/**
+ * @brief Frees all resources of the tour
+ * 
+ * @param t 
+ */
+void tour_free(tour* t);
+
+#endif
@@ -0,0 +1,251 @@
+#include "tspbin.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static size_t tspbin_element_size(tspbin_costs type){
+    switch(type){
+        case TSPBIN_COSTS_F32: return sizeof(float);
+        case TSPBIN_COSTS_U16: return sizeof(uint16_t);
+        case TSPBIN_COSTS_U32: return sizeof(uint32_t);
+        default:               return 0;
+    }
+}
+
+/**
+ * @brief Pads the file to TSPBIN_ALIGN and writes a section there
+ *
+ * @return uint64_t offset of the section, 0 on error
+ */
+static uint64_t tspbin_write_section(FILE* f, const void* data, size_t bytes){
+    static const char zeros[TSPBIN_ALIGN] = {0};
+
+    long pos = ftell(f);
+    if(pos < 0){
+        return 0;
+    }
+    size_t pad = (TSPBIN_ALIGN - pos % TSPBIN_ALIGN) % TSPBIN_ALIGN;
+    if(fwrite(zeros, 1, pad, f) != pad || fwrite(data, 1, bytes, f) != bytes){
+        return 0;
+    }
+
+    return pos + pad;
+}
+
+ERROR_CODE tspbin_write(const char* path, const point* points, int nnodes, const candidate_list* cl, tspbin_costs costs_type, bool costs_nint, double costs_scale, const void* costs){
+    if(nnodes <= 0){
+        return INVALID_ARGUMENT;
+    }
+
+    size_t len = strlen(path);
+    char* tmp_path = (char*) malloc(len + 5);
+    double* coords = (double*) malloc(nnodes * sizeof(double));
+    if(tmp_path == NULL || coords == NULL){
+        free(tmp_path);
+        free(coords);
+        return RESOURCE_EXHAUSTED;
+    }
+    snprintf(tmp_path, len + 5, "%s.tmp", path);
+
+    FILE* f = fopen(tmp_path, "wb");
+    if(f == NULL){
+        log_error("cannot write %s", tmp_path);
+        free(tmp_path);
+        free(coords);
+        return NOT_FOUND;
+    }
+
+    tspbin_header h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, TSPBIN_MAGIC, sizeof(h.magic));
+    h.version = TSPBIN_VERSION;
+    h.endian = TSPBIN_ENDIAN;
+    h.nnodes = nnodes;
+    h.candidates_type = CAND_NONE;
+    h.costs_type = TSPBIN_COSTS_NONE;
+
+    // placeholder, rewritten once the offsets are known
+    bool ok = fwrite(&h, sizeof(h), 1, f) == 1;
+
+    for(int i=0; i<nnodes; i++){
+        coords[i] = points[i].x;
+    }
+    ok = ok && (h.xs = tspbin_write_section(f, coords, nnodes * sizeof(double))) != 0;
+    for(int i=0; i<nnodes; i++){
+        coords[i] = points[i].y;
+    }
+    ok = ok && (h.ys = tspbin_write_section(f, coords, nnodes * sizeof(double))) != 0;
+
+    if(ok && cl != NULL && cl->type != CAND_NONE){
+        h.candidates_type = cl->type;
+        h.candidates_k = cl->k;
+        ok = (h.offsets = tspbin_write_section(f, cl->offsets, (nnodes + 1) * sizeof(int))) != 0;
+        ok = ok && (h.neighbors = tspbin_write_section(f, cl->neighbors, (size_t)cl->offsets[nnodes] * sizeof(int))) != 0;
+    }
+
+    if(ok && costs_type != TSPBIN_COSTS_NONE && costs != NULL && nnodes > 1){
+        size_t npairs = (size_t)nnodes * (nnodes - 1) / 2;
+        h.costs_type = costs_type;
+        h.costs_nint = costs_nint;
+        h.costs_scale = costs_scale;
+        ok = (h.costs = tspbin_write_section(f, costs, npairs * tspbin_element_size(costs_type))) != 0;
+    }
+
+    if(ok){
+        long size = ftell(f);
+        h.size = size < 0 ? 0 : size;
+        ok = size >= 0 && fseek(f, 0, SEEK_SET) == 0 && fwrite(&h, sizeof(h), 1, f) == 1;
+    }
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+
+    if(!ok){
+        log_error("cannot write %s", path);
+        remove(tmp_path);
+    }else{
+        log_info("instance cached in %s, %.1f MB", path, h.size / (1024.0 * 1024.0));
+    }
+
+    free(tmp_path);
+    free(coords);
+
+    return ok ? OK : INVALID_ARGUMENT;
+}
+
+/**
+ * @brief Checks that a section of count elements lies in the file and is aligned
+ */
+static bool tspbin_valid_section(const tspbin_header* h, uint64_t offset, uint64_t count, size_t element){
+    if(offset < sizeof(tspbin_header) || offset % TSPBIN_ALIGN != 0 || offset > h->size){
+        return false;
+    }
+    return count <= (h->size - offset) / element;
+}
+
+static ERROR_CODE tspbin_validate(tspbin* bin){
+    const tspbin_header* h = (const tspbin_header*) bin->map;
+
+    if(bin->size < sizeof(tspbin_header) || memcmp(h->magic, TSPBIN_MAGIC, sizeof(h->magic)) != 0){
+        log_error("not a tspbin file");
+        return INVALID_ARGUMENT;
+    }
+    if(h->version != TSPBIN_VERSION || h->endian != TSPBIN_ENDIAN){
+        log_error("tspbin version %u is not supported, or it was written with the other endianness", h->version);
+        return INVALID_ARGUMENT;
+    }
+    if(h->size != bin->size || h->nnodes <= 0){
+        log_error("truncated tspbin file");
+        return INVALID_ARGUMENT;
+    }
+
+    size_t n = h->nnodes;
+    if(!tspbin_valid_section(h, h->xs, n, sizeof(double)) || !tspbin_valid_section(h, h->ys, n, sizeof(double))){
+        log_error("invalid coordinates in the tspbin file");
+        return INVALID_ARGUMENT;
+    }
+    bin->nnodes = h->nnodes;
+    bin->xs = (const double*)((const char*) bin->map + h->xs);
+    bin->ys = (const double*)((const char*) bin->map + h->ys);
+
+    bin->candidates.type = CAND_NONE;
+    if(h->candidates_type != CAND_NONE){
+        if(h->candidates_type < CAND_KNN || h->candidates_type > CAND_ALPHA || h->candidates_k <= 0 ||
+            !tspbin_valid_section(h, h->offsets, n + 1, sizeof(int))){
+            log_error("invalid candidate lists in the tspbin file");
+            return INVALID_ARGUMENT;
+        }
+
+        const int* offsets = (const int*)((const char*) bin->map + h->offsets);
+        bool valid = offsets[0] == 0;
+        for(size_t i=0; valid && i<n; i++){
+            valid = offsets[i + 1] >= offsets[i] && offsets[i + 1] - offsets[i] <= h->candidates_k;
+        }
+        valid = valid && tspbin_valid_section(h, h->neighbors, offsets[n], sizeof(int));
+        const int* neighbors = valid ? (const int*)((const char*) bin->map + h->neighbors) : NULL;
+        for(int j=0; valid && j<offsets[n]; j++){
+            valid = neighbors[j] >= 0 && neighbors[j] < h->nnodes;
+        }
+        if(!valid){
+            log_error("invalid candidate lists in the tspbin file");
+            return INVALID_ARGUMENT;
+        }
+
+        bin->candidates.type = h->candidates_type;
+        bin->candidates.nnodes = h->nnodes;
+        bin->candidates.k = h->candidates_k;
+        bin->candidates.offsets = (int*) offsets;
+        bin->candidates.neighbors = (int*) neighbors;
+    }
+
+    bin->costs_type = TSPBIN_COSTS_NONE;
+    bin->costs_nint = false;
+    bin->costs = NULL;
+    if(h->costs_type != TSPBIN_COSTS_NONE){
+        size_t element = tspbin_element_size(h->costs_type);
+        if(element == 0 || n < 2 || !tspbin_valid_section(h, h->costs, n * (n - 1) / 2, element) || !(h->costs_scale >= 0)){
+            log_error("invalid costs in the tspbin file");
+            return INVALID_ARGUMENT;
+        }
+        bin->costs_type = h->costs_type;
+        bin->costs_nint = h->costs_nint != 0;
+        bin->costs_scale = h->costs_scale;
+        bin->costs = (const char*) bin->map + h->costs;
+    }
+
+    return OK;
+}
+
+ERROR_CODE tspbin_open(tspbin* bin, const char* path){
+    bin->map = NULL;
+    bin->size = 0;
+
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        log_error("cache file %s not found", path);
+        return NOT_FOUND;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (size_t) st.st_size < sizeof(tspbin_header)){
+        log_error("%s is not a tspbin file", path);
+        close(fd);
+        return INVALID_ARGUMENT;
+    }
+
+    void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        log_error("cannot map %s", path);
+        return RESOURCE_EXHAUSTED;
+    }
+    bin->map = map;
+    bin->size = st.st_size;
+
+    ERROR_CODE e = tspbin_validate(bin);
+    if(e != OK){
+        tspbin_close(bin);
+        return e;
+    }
+
+    // coordinates and lists are read right away, the costs as the search touches them
+    const tspbin_header* h = (const tspbin_header*) map;
+    size_t prefetch = h->costs != 0 ? h->costs : bin->size;
+    madvise(map, prefetch, MADV_WILLNEED);
+
+    log_debug("mapped %s: %d nodes, candidate lists %d, costs %d", path, bin->nnodes, bin->candidates.type, bin->costs_type);
+
+    return OK;
+}
+
+bool tspbin_contains(const tspbin* bin, const void* p){
+    return bin->map != NULL && (const char*) p >= (const char*) bin->map && (const char*) p < (const char*) bin->map + bin->size;
+}
+
+void tspbin_close(tspbin* bin){
+    if(bin->map != NULL){
+        munmap(bin->map, bin->size);
+        bin->map = NULL;
+        bin->size = 0;
+    }
+}
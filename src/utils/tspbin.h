@@ -0,0 +1,116 @@
+#ifndef TSPBIN_H_
+#define TSPBIN_H_
+
+/**
+ * @file tspbin.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Binary cache of an instance (.tspbin), written once and memory mapped read-only by later runs
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "candidates.h"
+
+#define TSPBIN_MAGIC "TSPBIN\0"     // 8 bytes with the terminator
+#define TSPBIN_VERSION 2
+#define TSPBIN_ENDIAN 0x01020304    // read back byte-swapped on a machine of the other endianness
+#define TSPBIN_ALIGN 64             // alignment of every section in the file
+
+/**
+ * @brief Element type of the packed costs in the cache
+ *
+ */
+typedef enum {
+    TSPBIN_COSTS_NONE = 0,
+    TSPBIN_COSTS_F32 = 1,       // float32 upper triangle
+    TSPBIN_COSTS_U16 = 2,       // uint16 upper triangle times costs_scale
+    TSPBIN_COSTS_U32 = 3        // uint32 upper triangle times costs_scale
+} tspbin_costs;
+
+/**
+ * @brief Header at the start of the file. Sections are given by their offset from the start
+ * of the file, 0 when absent, and are aligned to TSPBIN_ALIGN
+ *
+ */
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t endian;
+    int32_t nnodes;
+    int32_t candidates_type;    // candidate_type of the lists, CAND_NONE if absent
+    int32_t candidates_k;
+    int32_t costs_type;         // tspbin_costs
+    int32_t costs_nint;         // 1 if the costs are TSPLIB EUC_2D integer distances
+    int32_t reserved;           // keeps costs_scale aligned
+    double costs_scale;
+    uint64_t size;              // size of the whole file
+    uint64_t xs;                // nnodes doubles
+    uint64_t ys;                // nnodes doubles
+    uint64_t offsets;           // nnodes + 1 int32 offsets of the candidate lists
+    uint64_t neighbors;         // offsets[nnodes] int32 neighbors
+    uint64_t costs;             // nnodes * (nnodes - 1) / 2 packed costs, row by row without diagonal
+} tspbin_header;
+
+/**
+ * @brief Mapped cache. Every pointer is into the read-only mapping and stays valid until tspbin_close
+ *
+ */
+typedef struct {
+    void* map;                  // NULL if nothing is mapped
+    size_t size;
+
+    int nnodes;
+    const double* xs;           // SoA coordinates
+    const double* ys;
+    candidate_list candidates;  // type CAND_NONE if the file has no lists, never passed to cand_free
+    tspbin_costs costs_type;
+    bool costs_nint;            // costs are integer distances
+    double costs_scale;
+    const void* costs;          // packed costs, NULL if the file has none
+} tspbin;
+
+/**
+ * @brief Writes the cache to path.tmp and renames it to path, so that readers never map a partial file
+ *
+ * @param path file to write
+ * @param points points of the instance
+ * @param nnodes number of points
+ * @param cl candidate lists, NULL or CAND_NONE to leave them out
+ * @param costs_type element type of costs, TSPBIN_COSTS_NONE to leave them out
+ * @param costs_nint true if the costs are integer distances
+ * @param costs_scale length of one quantization step
+ * @param costs packed upper triangle without diagonal
+ * @return ERROR_CODE
+ */
+ERROR_CODE tspbin_write(const char* path, const point* points, int nnodes, const candidate_list* cl, tspbin_costs costs_type, bool costs_nint, double costs_scale, const void* costs);
+
+/**
+ * @brief Maps the cache read-only and shared, so that processes loading the same file share the
+ * page cache. Header, section bounds and candidate lists are validated, nothing is copied
+ *
+ * @param bin
+ * @param path
+ * @return ERROR_CODE NOT_FOUND if the file cannot be opened, INVALID_ARGUMENT if it is not a valid cache
+ */
+ERROR_CODE tspbin_open(tspbin* bin, const char* path);
+
+/**
+ * @brief Util to check if p points into the mapping
+ *
+ * @param bin
+ * @param p
+ * @return true if p is owned by the mapping and must not be freed
+ */
+bool tspbin_contains(const tspbin* bin, const void* p);
+
+/**
+ * @brief Unmaps the cache, if any
+ *
+ * @param bin
+ */
+void tspbin_close(tspbin* bin);
+
+#endif
@@ -0,0 +1,618 @@
+#include "tsplib.h"
+#include "threads.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+#define TSPLIB_MAX_DIGITS 19        // significant digits that fit in a uint64_t
+#define TSPLIB_MAX_NUMBER 400       // longest number handed to strtod
+
+// powers of ten that are exact in a double
+static const double tsplib_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+static inline bool tsplib_blank(char c){
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool tsplib_digit(char c){
+    return c >= '0' && c <= '9';
+}
+
+static inline bool tsplib_letter(char c){
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+const char* tsplib_parse_double(const char* begin, const char* end, double* value){
+    const char* p = begin;
+    bool negative = false;
+    if(p < end && (*p == '-' || *p == '+')){
+        negative = *p == '-';
+        p++;
+    }
+
+    uint64_t mantissa = 0;
+    int digits = 0;                 // significant digits in mantissa
+    int exponent = 0;
+    bool any = false, truncated = false;
+
+    for(; p < end && tsplib_digit(*p); p++){
+        any = true;
+        if(digits < TSPLIB_MAX_DIGITS){
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa != 0;
+        }else{
+            truncated |= *p != '0';
+            exponent++;
+        }
+    }
+    if(p < end && *p == '.'){
+        for(p++; p < end && tsplib_digit(*p); p++){
+            any = true;
+            if(digits < TSPLIB_MAX_DIGITS){
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa != 0;
+                exponent--;
+            }else{
+                truncated |= *p != '0';
+            }
+        }
+    }
+    if(!any){
+        return begin;
+    }
+
+    // the exponent is part of the number only if it has digits
+    if(p < end && (*p == 'e' || *p == 'E')){
+        const char* q = p + 1;
+        bool negative_exp = false;
+        if(q < end && (*q == '-' || *q == '+')){
+            negative_exp = *q == '-';
+            q++;
+        }
+        if(q < end && tsplib_digit(*q)){
+            int e = 0;
+            for(; q < end && tsplib_digit(*q); q++){
+                if(e < 100000){
+                    e = e * 10 + (*q - '0');
+                }
+            }
+            exponent += negative_exp ? -e : e;
+            p = q;
+        }
+    }
+
+    // both mantissa and power of ten are exact, so one multiplication or division rounds correctly
+    if(!truncated && mantissa < (1ULL << 53) && exponent >= -22 && exponent <= 22){
+        double v = (double) mantissa;
+        v = exponent >= 0 ? v * tsplib_pow10[exponent] : v / tsplib_pow10[-exponent];
+        *value = negative ? -v : v;
+        return p;
+    }
+
+    char buffer[TSPLIB_MAX_NUMBER + 1];
+    size_t len = p - begin;
+    if(len > TSPLIB_MAX_NUMBER){
+        return begin;
+    }
+    memcpy(buffer, begin, len);
+    buffer[len] = '\0';
+    *value = strtod(buffer, NULL);
+
+    return p;
+}
+
+//================================================================================
+// STDIO
+//================================================================================
+
+static ERROR_CODE tsplib_read_stdio(const char* path, int* nnodes, point** points, size_t* bytes){
+    FILE* input_file = fopen(path, "r");
+    if(input_file == NULL){
+        log_error("input file %s not found", path);
+        return NOT_FOUND;
+    }
+
+    ERROR_CODE e = OK;
+    char line[300];
+    char *token2, *token1, *parameter;
+    int node_section = 0;
+
+    while(e == OK && fgets(line, sizeof(line), input_file) != NULL){
+        *bytes += strlen(line);
+        if(strlen(line) <= 1) continue; // skip empty lines
+        parameter = strtok(line, " :");
+
+        if(strncmp(parameter, "DIMENSION", 9) == 0){
+            token1 = strtok(NULL, " :");
+            if(*nnodes >= 0 || token1 == NULL || atoi(token1) <= 0){
+                log_error("invalid or repeated DIMENSION in the file");
+                e = INVALID_ARGUMENT;
+                break;
+            }
+            *nnodes = atoi(token1);
+            *points = (point*) calloc(*nnodes, sizeof(point));
+            if(*points == NULL){
+                e = RESOURCE_EXHAUSTED;
+            }
+            continue;
+        }
+
+        if(strncmp(parameter, "NODE_COORD_SECTION", 18) == 0){
+            if(*nnodes <= 0){
+                log_error("DIMENSION not found");
+                e = INVALID_ARGUMENT;
+            }
+            node_section = 1;
+            continue;
+        }
+
+        if(strncmp(parameter, "TYPE", 4) == 0){
+            token1 = strtok(NULL, " :");
+            if(token1 == NULL || strncmp(token1, "TSP", 3) != 0){
+                log_error("format error: only TSP file type accepted");
+                e = INVALID_ARGUMENT;
+            }
+            continue;
+        }
+
+        if(strncmp(parameter, "EDGE_WEIGHT_TYPE", 16) == 0){
+            token1 = strtok(NULL, " :");
+            if(token1 == NULL || strncmp(token1, "EUC_2D", 6) != 0){
+                log_error("format error: only EDGE_WEIGHT_TYPE == EUC_2D managed");
+                e = INVALID_ARGUMENT;
+            }
+            continue;
+        }
+
+        if(strncmp(parameter, "EOF", 3) == 0){
+            break;
+        }
+
+        if(node_section){
+            int i = atoi(parameter) - 1; //index
+            token1 = strtok(NULL, " :,");
+            token2 = strtok(NULL, " :,");
+            if(i < 0 || i >= *nnodes || token1 == NULL || token2 == NULL){
+                log_error("invalid node %s in the file", parameter);
+                e = INVALID_ARGUMENT;
+                break;
+            }
+            point new_point;
+            new_point.x = atof(token1);
+            new_point.y = atof(token2);
+            (*points)[i] = new_point;
+            continue;
+        }
+    }
+
+    if(e == OK && !node_section){
+        log_error("NODE_COORD_SECTION not found");
+        e = INVALID_ARGUMENT;
+    }
+
+    fclose(input_file);
+
+    return e;
+}
+
+//================================================================================
+// MMAP
+//================================================================================
+
+/**
+ * @brief Coordinates parsed by one worker, from begin to the first keyword or to end
+ */
+typedef struct {
+    const char* begin;
+    const char* end;
+    const char* keyword;        // first line of the chunk that starts with a letter, NULL if none
+    const char* error;          // first malformed line, NULL if none
+    int count;                  // nodes parsed
+} tsplib_chunk;
+
+/**
+ * @brief Shared state of the workers parsing the coordinate section
+ */
+typedef struct {
+    int nnodes;
+    point* points;
+    char* seen;                 // 1 once the node has been read, to reject duplicates
+    tsplib_chunk* chunks;
+} tsplib_job;
+
+static const char* tsplib_skip_blanks(const char* p, const char* end){
+    while(p < end && tsplib_blank(*p)){
+        p++;
+    }
+    return p;
+}
+
+static const char* tsplib_next_line(const char* p, const char* end){
+    const char* newline = memchr(p, '\n', end - p);
+    return newline == NULL ? end : newline + 1;
+}
+
+/**
+ * @brief Parses lines "index x y" until a line that starts with a letter, e.g. EOF
+ */
+static void tsplib_parse_chunk(tsplib_job* job, tsplib_chunk* chunk){
+    const char* p = chunk->begin;
+    const char* end = chunk->end;
+
+    while(p < end){
+        const char* line = p;
+        p = tsplib_skip_blanks(p, end);
+        if(p == end){
+            break;
+        }
+        if(*p == '\n'){
+            p++;
+            continue;
+        }
+        if(tsplib_letter(*p)){
+            chunk->keyword = line;
+            return;
+        }
+
+        // index, checked against DIMENSION before it is used
+        long index = 0;
+        const char* digits = p;
+        while(p < end && tsplib_digit(*p) && index <= job->nnodes){
+            index = index * 10 + (*p++ - '0');
+        }
+        bool valid = p > digits && index >= 1 && index <= job->nnodes && p < end && tsplib_blank(*p);
+
+        double x = 0, y = 0;
+        if(valid){
+            const char* q = tsplib_parse_double(p = tsplib_skip_blanks(p, end), end, &x);
+            valid = q > p && q < end && tsplib_blank(*q);
+            p = q;
+        }
+        if(valid){
+            const char* q = tsplib_parse_double(p = tsplib_skip_blanks(p, end), end, &y);
+            valid = q > p;
+            p = tsplib_skip_blanks(q, end);
+            valid &= p == end || *p == '\n';
+        }
+        if(valid && __atomic_exchange_n(&job->seen[index - 1], 1, __ATOMIC_RELAXED)){
+            valid = false;
+        }
+        if(!valid){
+            chunk->error = line;
+            return;
+        }
+
+        job->points[index - 1].x = x;
+        job->points[index - 1].y = y;
+        chunk->count++;
+        p = tsplib_next_line(p, end);
+    }
+}
+
+static void tsplib_parse_task(void* ctx, int thread_id, int nthreads){
+    (void) nthreads;
+    tsplib_job* job = (tsplib_job*) ctx;
+    tsplib_parse_chunk(job, &job->chunks[thread_id]);
+}
+
+/**
+ * @brief Parses the coordinate section on nchunks workers, split at line starts
+ */
+static ERROR_CODE tsplib_parse_section(tsplib_job* job, const char* map, const char* begin, const char* end, int nchunks){
+    for(int k=0; k<nchunks; k++){
+        tsplib_chunk* chunk = &job->chunks[k];
+        chunk->begin = k == 0 ? begin : job->chunks[k - 1].end;
+        chunk->end = k == nchunks - 1 ? end : begin + (end - begin) / nchunks * (k + 1);
+        if(chunk->end < chunk->begin){
+            chunk->end = chunk->begin;
+        }else if(k < nchunks - 1){
+            chunk->end = tsplib_next_line(chunk->end, end);
+        }
+        chunk->keyword = NULL;
+        chunk->error = NULL;
+        chunk->count = 0;
+    }
+
+    threads_run(nchunks, tsplib_parse_task, job);
+
+    // the section ends at the first keyword, chunks after it must be empty
+    int count = 0;
+    bool ended = false;
+    for(int k=0; k<nchunks; k++){
+        tsplib_chunk* chunk = &job->chunks[k];
+        if(ended){
+            if(chunk->count > 0 || chunk->error != NULL){
+                return CANCELLED;
+            }
+            continue;
+        }
+        if(chunk->error != NULL){
+            const char* line_end = tsplib_next_line(chunk->error, end);
+            while(line_end > chunk->error && (line_end[-1] == '\n' || line_end[-1] == '\r')){
+                line_end--;
+            }
+            log_error("malformed or repeated node at byte %zu: %.*s", (size_t)(chunk->error - map), (int)(line_end - chunk->error), chunk->error);
+            return INVALID_ARGUMENT;
+        }
+        count += chunk->count;
+        ended = chunk->keyword != NULL;
+    }
+
+    if(count != job->nnodes){
+        log_error("%d nodes missing in NODE_COORD_SECTION", job->nnodes - count);
+        return INVALID_ARGUMENT;
+    }
+
+    return OK;
+}
+
+/**
+ * @brief Value of a header line "KEYWORD : value", NULL if the keyword does not match
+ */
+static const char* tsplib_header_value(const char* p, const char* end, const char* keyword){
+    size_t len = strlen(keyword);
+    if((size_t)(end - p) < len || memcmp(p, keyword, len) != 0){
+        return NULL;
+    }
+    p += len;
+    if(p < end && !tsplib_blank(*p) && *p != ':' && *p != '\n'){
+        return NULL;
+    }
+    while(p < end && (tsplib_blank(*p) || *p == ':')){
+        p++;
+    }
+    return p;
+}
+
+static ERROR_CODE tsplib_read_mmap(const char* path, int nthreads, int* nnodes, point** points, size_t* bytes){
+    int fd = open(path, O_RDONLY);
+    if(fd < 0){
+        log_error("input file %s not found", path);
+        return NOT_FOUND;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || st.st_size == 0){
+        log_error("cannot read %s", path);
+        close(fd);
+        return INVALID_ARGUMENT;
+    }
+    *bytes = st.st_size;
+
+    const char* map = (const char*) mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(map == MAP_FAILED){
+        log_error("cannot map %s", path);
+        return RESOURCE_EXHAUSTED;
+    }
+    madvise((void*) map, st.st_size, MADV_SEQUENTIAL);
+
+    const char* end = map + st.st_size;
+    const char* p = map;
+    const char* section = NULL;
+    ERROR_CODE e = OK;
+
+    // header, one "KEYWORD : value" per line
+    while(e == OK && section == NULL && p < end){
+        const char* line = tsplib_skip_blanks(p, end);
+        p = tsplib_next_line(line, end);
+        const char* value;
+
+        if((value = tsplib_header_value(line, end, "DIMENSION")) != NULL){
+            long n = 0;
+            while(value < end && tsplib_digit(*value) && n <= __INT_MAX__){
+                n = n * 10 + (*value++ - '0');
+            }
+            if(*nnodes >= 0 || n <= 0 || n > __INT_MAX__){
+                log_error("invalid or repeated DIMENSION in the file");
+                e = INVALID_ARGUMENT;
+            }
+            *nnodes = (int) n;
+        }else if((value = tsplib_header_value(line, end, "TYPE")) != NULL){
+            if(end - value < 3 || memcmp(value, "TSP", 3) != 0){
+                log_error("format error: only TSP file type accepted");
+                e = INVALID_ARGUMENT;
+            }
+        }else if((value = tsplib_header_value(line, end, "EDGE_WEIGHT_TYPE")) != NULL){
+            if(end - value < 6 || memcmp(value, "EUC_2D", 6) != 0){
+                log_error("format error: only EDGE_WEIGHT_TYPE == EUC_2D managed");
+                e = INVALID_ARGUMENT;
+            }
+        }else if(tsplib_header_value(line, end, "NODE_COORD_SECTION") != NULL){
+            section = p;
+        }else if(tsplib_header_value(line, end, "EOF") != NULL){
+            break;
+        }
+    }
+
+    if(e == OK && section == NULL){
+        log_error("NODE_COORD_SECTION not found");
+        e = INVALID_ARGUMENT;
+    }
+    if(e == OK && *nnodes <= 0){
+        log_error("DIMENSION not found");
+        e = INVALID_ARGUMENT;
+    }
+
+    tsplib_job job;
+    job.nnodes = *nnodes;
+    job.points = NULL;
+    job.seen = NULL;
+    job.chunks = NULL;
+    if(e == OK){
+        // small sections are not worth the threads
+        int nchunks = (end - section) < TSPLIB_PARALLEL_BYTES ? 1 : nthreads;
+        job.points = (point*) calloc(*nnodes, sizeof(point));
+        job.seen = (char*) calloc(*nnodes, sizeof(char));
+        job.chunks = (tsplib_chunk*) malloc(nchunks * sizeof(tsplib_chunk));
+        if(job.points == NULL || job.seen == NULL || job.chunks == NULL){
+            e = RESOURCE_EXHAUSTED;
+        }else{
+            e = tsplib_parse_section(&job, map, section, end, nchunks);
+
+            // lines after the end of the section were parsed as nodes, a single worker stops at the end
+            if(e == CANCELLED){
+                log_debug("data after the coordinate section, parsing it again on one thread");
+                memset(job.seen, 0, *nnodes * sizeof(char));
+                e = tsplib_parse_section(&job, map, section, end, 1);
+            }
+        }
+    }
+
+    if(e == OK){
+        *points = job.points;
+    }else{
+        free(job.points);
+    }
+    free(job.seen);
+    free(job.chunks);
+    munmap((void*) map, st.st_size);
+
+    return e;
+}
+
+//================================================================================
+// READER
+//================================================================================
+
+ERROR_CODE tsplib_read(const char* path, tsplib_parser parser, int nthreads, int* nnodes, point** points){
+    struct timespec start, stop;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    *nnodes = -1;
+    *points = NULL;
+    size_t bytes = 0;
+
+    ERROR_CODE e = parser == PARSER_STDIO ?
+        tsplib_read_stdio(path, nnodes, points, &bytes) :
+        tsplib_read_mmap(path, nthreads > 1 ? nthreads : 1, nnodes, points, &bytes);
+    if(e != OK){
+        free(*points);
+        *points = NULL;
+        return e;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &stop);
+    double seconds = (stop.tv_sec - start.tv_sec) + (stop.tv_nsec - start.tv_nsec) * 1e-9;
+    double mb = bytes / (1024.0 * 1024.0);
+    log_info("parsed %d nodes with the %s parser: %.1f MB in %.3f s, %.1f MB/s",
+        *nnodes, parser == PARSER_STDIO ? "stdio" : "mmap", mb, seconds, seconds > 0 ? mb / seconds : 0.0);
+
+    return OK;
+}
+
+//================================================================================
+// TOURS
+//================================================================================
+
+ERROR_CODE tsplib_read_tour(const char* path, int nnodes, int* order){
+    FILE* f = fopen(path, "r");
+    if(f == NULL){
+        log_error("tour file %s not found", path);
+        return NOT_FOUND;
+    }
+
+    ERROR_CODE e = OK;
+    char line[300];
+    bool section = false;
+
+    // header, one "KEYWORD : value" per line
+    while(e == OK && !section && fgets(line, sizeof(line), f) != NULL){
+        char* parameter = strtok(line, " :\t\r\n");
+        if(parameter == NULL){
+            continue;
+        }
+
+        if(strcmp(parameter, "DIMENSION") == 0){
+            char* token = strtok(NULL, " :\t\r\n");
+            if(token == NULL || atoi(token) != nnodes){
+                log_error("the tour has DIMENSION %s, the instance %d nodes", token == NULL ? "" : token, nnodes);
+                e = INVALID_ARGUMENT;
+            }
+        }else if(strcmp(parameter, "TYPE") == 0){
+            char* token = strtok(NULL, " :\t\r\n");
+            if(token == NULL || strcmp(token, "TOUR") != 0){
+                log_error("format error: only TOUR file type accepted");
+                e = INVALID_ARGUMENT;
+            }
+        }else if(strcmp(parameter, "TOUR_SECTION") == 0){
+            section = true;
+        }else if(strcmp(parameter, "EOF") == 0){
+            break;
+        }
+    }
+
+    if(e == OK && !section){
+        log_error("TOUR_SECTION not found");
+        e = INVALID_ARGUMENT;
+    }
+
+    // node ids from 1, in visiting order, closed by -1
+    char* seen = e == OK ? (char*) calloc(nnodes, sizeof(char)) : NULL;
+    if(e == OK && seen == NULL){
+        e = RESOURCE_EXHAUSTED;
+    }
+    int count = 0, id;
+    while(e == OK && fscanf(f, "%d", &id) == 1 && id != -1){
+        if(id < 1 || id > nnodes || seen[id - 1] || count == nnodes){
+            log_error("invalid or repeated node %d in the tour", id);
+            e = INVALID_ARGUMENT;
+            break;
+        }
+        seen[id - 1] = 1;
+        order[count++] = id - 1;
+    }
+    if(e == OK && count != nnodes){
+        log_error("the tour visits %d nodes out of %d", count, nnodes);
+        e = INVALID_ARGUMENT;
+    }
+
+    free(seen);
+    fclose(f);
+
+    return e;
+}
+
+ERROR_CODE tsplib_write_tour(const char* path, const char* name, int nnodes, const int* order, double cost){
+    size_t len = strlen(path);
+    char* tmp_path = (char*) malloc(len + 5);
+    if(tmp_path == NULL){
+        return RESOURCE_EXHAUSTED;
+    }
+    snprintf(tmp_path, len + 5, "%s.tmp", path);
+
+    FILE* f = fopen(tmp_path, "w");
+    if(f == NULL){
+        log_error("cannot write %s", tmp_path);
+        free(tmp_path);
+        return NOT_FOUND;
+    }
+
+    fprintf(f, "NAME : %s\n", name);
+    fprintf(f, "COMMENT : Length %.6f\n", cost);
+    fprintf(f, "TYPE : TOUR\n");
+    fprintf(f, "DIMENSION : %d\n", nnodes);
+    fprintf(f, "TOUR_SECTION\n");
+    for(int i=0; i<nnodes; i++){
+        fprintf(f, "%d\n", order[i] + 1);
+    }
+    fprintf(f, "-1\nEOF\n");
+
+    bool ok = !ferror(f);
+    ok = fclose(f) == 0 && ok;
+    ok = ok && rename(tmp_path, path) == 0;
+    if(!ok){
+        log_error("cannot write %s", path);
+        remove(tmp_path);
+    }
+
+    free(tmp_path);
+
+    return ok ? OK : INVALID_ARGUMENT;
+}
@@ -0,0 +1,76 @@
+#ifndef TSPLIB_H_
+#define TSPLIB_H_
+
+/**
+ * @file tsplib.h
+ * @author Enrico Bolzonello (enrico.bolzonello@studenti.unipd.it), Riccardo Vendramin (riccardo.vendramin.1@studenti.unipd.it)
+ * @brief Readers of TSPLIB files with EUC_2D coordinates, readers and writers of TSPLIB tours
+ * @version 0.1
+ * @date 2026-10-18
+ *
+ * @copyright Copyright (c) 2024
+ *
+ */
+
+#include "utils.h"
+
+#define TSPLIB_PARALLEL_BYTES (4 << 20)     // smallest coordinate section split among threads
+
+/**
+ * @brief How the file is read
+ *
+ */
+typedef enum {
+    PARSER_STDIO = 0,           // line by line with fgets, strtok and atof
+    PARSER_MMAP = 1             // memory mapped, numbers parsed in place, optionally split among threads
+} tsplib_parser;
+
+/**
+ * @brief Reads DIMENSION and NODE_COORD_SECTION of a TSP file with EUC_2D weights. Node indices
+ * must go from 1 to DIMENSION, each one exactly once
+ *
+ * @param path file to read
+ * @param parser reader to use
+ * @param nthreads threads that parse the coordinates, for PARSER_MMAP
+ * @param nnodes DIMENSION of the file
+ * @param points allocated array of nnodes points, owned by the caller
+ * @return ERROR_CODE NOT_FOUND if the file cannot be opened, INVALID_ARGUMENT if it is malformed
+ */
+ERROR_CODE tsplib_read(const char* path, tsplib_parser parser, int nthreads, int* nnodes, point** points);
+
+/**
+ * @brief Parses a decimal number, as strtod, without locale or copies: the fast path keeps up to
+ * 19 significant digits in an integer and scales it by an exact power of ten, longer or
+ * out of range numbers go through strtod
+ *
+ * @param begin first character, leading blanks are not skipped
+ * @param end end of the buffer, not dereferenced
+ * @param value parsed number
+ * @return const char* first character after the number, begin if there is no number
+ */
+const char* tsplib_parse_double(const char* begin, const char* end, double* value);
+
+/**
+ * @brief Reads the TOUR_SECTION of a TSPLIB tour file: node ids from 1 in visiting order, closed by -1
+ *
+ * @param path file to read
+ * @param nnodes nodes of the instance, DIMENSION must match it if present
+ * @param order nnodes nodes from 0, in visiting order
+ * @return ERROR_CODE NOT_FOUND if the file cannot be opened, INVALID_ARGUMENT if it is not a tour of the instance
+ */
+ERROR_CODE tsplib_read_tour(const char* path, int nnodes, int* order);
+
+/**
+ * @brief Writes a TSPLIB tour file to path.tmp and renames it to path, so that a killed run
+ * never leaves a partial tour
+ *
+ * @param path file to write
+ * @param name NAME of the tour
+ * @param nnodes
+ * @param order nodes from 0, in visiting order
+ * @param cost length written in the COMMENT
+ * @return ERROR_CODE
+ */
+ERROR_CODE tsplib_write_tour(const char* path, const char* name, int nnodes, const int* order, double cost);
+
+#endif
@@ -1,7 +1,7 @@
 #include "utils.h"
 
-static char* algs_string[6] = {
-    "Greedy", "Greedy\\_Iter", "2opt\\_Greedy", "Tabu\\_Search", "VNS", "CPLEX"
+static char* algs_string[9] = {
+    "Greedy", "Greedy\\_Iter", "2opt\\_Greedy", "Tabu\\_Search", "VNS", "CPLEX", "3opt", "LK", "2opt"
 };
 
 bool utils_file_exists (const char *filename) {
@@ -18,23 +18,6 @@ bool utils_invalid_input(int i, int argc, bool* help){
     return false;
 }
 
-struct utils_clock utils_startclock(void){
-  struct utils_clock c;
-  c.starting_time = clock();
-  c.started = true;
-
-  return c;
-}
-
-double utils_timeelapsed(struct utils_clock c){
-  if(!c.started){
-    log_debug("clock not started");
-    exit(0);
-  }
-
-  return (double) (clock() - c.starting_time) / CLOCKS_PER_SEC;
-}
-
 void utils_print_array(int* arr){
   int size = sizeof(*arr) / sizeof(arr[0]);
 
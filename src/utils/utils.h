@@ -17,6 +17,7 @@
 #include <errno.h>
 
 #include "errors.h"
+#include "rng.h"
 
 
 #define COLOR_BOLD  "\033[1m"
@@ -25,7 +26,7 @@
 #define MAX_COORDINATE 10000
 #define MIN_COORDINATE -10000
 
-#define TSP_RAND() ( ((double)rand() / RAND_MAX) * (MAX_COORDINATE - MIN_COORDINATE) + MIN_COORDINATE )
+#define TSP_RAND(rng) ( rng_double(rng) * (MAX_COORDINATE - MIN_COORDINATE) + MIN_COORDINATE )
 
 #define NOT_CONNECTED -1.0f
 
@@ -34,16 +35,8 @@ typedef struct {
     double y;
 } point;
 
-struct utils_clock{
-    bool started;
-    clock_t starting_time;
-};
-
-
 bool utils_file_exists(const char *filename);
 bool utils_invalid_input(int i, int argc, bool* help);
-struct utils_clock utils_startclock(void);
-double utils_timeelapsed(struct utils_clock c);
 void utils_plotname(char* buffer, int buffersize);
 void utils_format_title(char *fname, int alg);
 void swap(int* a, int* b);
@@ -0,0 +1,194 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include <string.h>
+
+#include "utils/tour.h"
+#include "utils/rng.h"
+
+#define TOUR_STRESS_MOVES 20000
+#define TOUR_ADVERSARIAL_MOVES 300
+#define TOUR_ADVERSARIAL_TRIES 16
+
+//================================================================================
+// TOUR
+//================================================================================
+
+/**
+ * @brief Checks that the two tours have the same undirected edges, the two-level one may run
+ * in the other direction
+ */
+static void assert_same_edges(tour* two_level, tour* array){
+    const int* succ = tour_successors(two_level);
+    for(int i=0; i<array->nnodes; i++){
+        int next = tour_next(array, i);
+        int prev = tour_prev(array, i);
+        assert_true((succ[i] == next && tour_prev(two_level, i) == prev) || (succ[i] == prev && tour_prev(two_level, i) == next));
+    }
+}
+
+/**
+ * @brief Copies the two-level list of src into dst, allocated with the same size
+ */
+static void tour_copy(tour* dst, const tour* src){
+    int n = src->nnodes;
+    dst->group = src->group;
+    dst->nsegments = src->nsegments;
+    dst->nfree = src->nfree;
+    dst->succ_valid = false;
+    memcpy(dst->segments, src->segments, src->max_segments * sizeof(tour_segment));
+    memcpy(dst->segment_order, src->segment_order, src->max_segments * sizeof(int));
+    memcpy(dst->free_segments, src->free_segments, src->max_segments * sizeof(int));
+    memcpy(dst->node_pool, src->node_pool, (size_t)src->max_segments * src->group * sizeof(int));
+    memcpy(dst->seg, src->seg, n * sizeof(int));
+    memcpy(dst->idx, src->idx, n * sizeof(int));
+}
+
+/**
+ * @brief Picks a legal 2opt move, b a few steps after a if short
+ * 
+ * @return false if a and b are too close
+ */
+static bool tour_pick_move(tour* array, rng_state* rng, int group, bool short_moves, int* move){
+    int n = array->nnodes;
+    int a = rng_int(rng, n);
+    int b = a;
+    if(short_moves){
+        int steps = 2 + rng_int(rng, group);
+        for(int s=0; s<steps; s++){
+            b = tour_next(array, b);
+        }
+    }else{
+        b = rng_int(rng, n);
+    }
+
+    move[0] = a;
+    move[1] = tour_next(array, a);
+    move[2] = b;
+    move[3] = tour_next(array, b);
+    return a != b && move[1] != b && move[3] != a;
+}
+
+/**
+ * @brief Every legal 2opt move on the two-level list, checked against the array; short reversals
+ * split segments in the middle, the worst case for the segment pool
+ */
+static void tour_stress(int nnodes, bool short_moves){
+    tour two_level, array;
+    assert_int_equal(tour_init_type(&two_level, nnodes, TOUR_TWO_LEVEL), OK);
+    assert_int_equal(tour_init_type(&array, nnodes, TOUR_ARRAY), OK);
+
+    int* succ = (int*) malloc(nnodes * sizeof(int));
+    assert_non_null(succ);
+    for(int i=0; i<nnodes; i++){
+        succ[i] = (i + 1) % nnodes;
+    }
+    tour_from_successors(&two_level, succ);
+    tour_from_successors(&array, succ);
+
+    rng_state rng;
+    rng_seed(&rng, nnodes);
+    for(int k=0; k<TOUR_STRESS_MOVES; k++){
+        int move[4];
+        if(!tour_pick_move(&array, &rng, two_level.group, short_moves, move)){
+            continue;
+        }
+
+        // the same move by its removed edges, the two-level tour may run the other way
+        tour_2opt_move(&array, move[0], move[2]);
+        tour_swap_edges(&two_level, move[0], move[1], move[2], move[3]);
+
+        // adjacent segments never fit in one
+        assert_true(two_level.nsegments <= 2 * nnodes / two_level.group + 1);
+        if(k % 97 == 0){
+            assert_same_edges(&two_level, &array);
+        }
+    }
+    assert_same_edges(&two_level, &array);
+
+    free(succ);
+    tour_free(&two_level);
+    tour_free(&array);
+}
+
+/**
+ * @brief Moves chosen to leave as many segments as possible: out of a few legal moves, the one
+ * that splits the most on a copy of the list is applied
+ */
+static void tour_adversarial(int nnodes){
+    tour two_level, array, scratch;
+    assert_int_equal(tour_init_type(&two_level, nnodes, TOUR_TWO_LEVEL), OK);
+    assert_int_equal(tour_init_type(&scratch, nnodes, TOUR_TWO_LEVEL), OK);
+    assert_int_equal(tour_init_type(&array, nnodes, TOUR_ARRAY), OK);
+
+    int* succ = (int*) malloc(nnodes * sizeof(int));
+    assert_non_null(succ);
+    for(int i=0; i<nnodes; i++){
+        succ[i] = (i + 1) % nnodes;
+    }
+    tour_from_successors(&two_level, succ);
+    tour_from_successors(&array, succ);
+
+    rng_state rng;
+    rng_seed(&rng, nnodes);
+    for(int k=0; k<TOUR_ADVERSARIAL_MOVES; k++){
+        int best[4], best_segments = -1;
+        for(int tries=0; tries<TOUR_ADVERSARIAL_TRIES; tries++){
+            int move[4];
+            if(!tour_pick_move(&array, &rng, two_level.group, tries % 2 == 0, move)){
+                continue;
+            }
+            tour_copy(&scratch, &two_level);
+            tour_swap_edges(&scratch, move[0], move[1], move[2], move[3]);
+            if(scratch.nsegments > best_segments){
+                best_segments = scratch.nsegments;
+                memcpy(best, move, sizeof(best));
+            }
+        }
+        if(best_segments == -1){
+            continue;
+        }
+
+        tour_2opt_move(&array, best[0], best[2]);
+        tour_swap_edges(&two_level, best[0], best[1], best[2], best[3]);
+
+        assert_true(two_level.nsegments <= 2 * nnodes / two_level.group + 1);
+        assert_same_edges(&two_level, &array);
+    }
+
+    free(succ);
+    tour_free(&two_level);
+    tour_free(&scratch);
+    tour_free(&array);
+}
+
+static void test_tour_random_moves(void** state){
+    (void) state;
+    tour_stress(1000, false);
+    tour_stress(5000, false);
+}
+
+static void test_tour_short_moves(void** state){
+    (void) state;
+    tour_stress(1000, true);
+    tour_stress(5000, true);
+}
+
+static void test_tour_adversarial_moves(void** state){
+    (void) state;
+    tour_adversarial(1000);
+    tour_adversarial(5000);
+}
+
+int main(void){
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_tour_random_moves),
+        cmocka_unit_test(test_tour_short_moves),
+        cmocka_unit_test(test_tour_adversarial_moves),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
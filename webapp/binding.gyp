@@ -11,8 +11,17 @@
                 "../src/algorithms/heuristics.c",
                 "../src/algorithms/metaheuristic.c",
                 "../src/algorithms/refinment.c",
+                "../src/utils/candidates.c",
+                "../src/utils/deadline.c",
                 "../src/utils/errors.c",
+                "../src/utils/kdtree.c",
                 "../src/utils/plot.c",
+                "../src/utils/rng.c",
+                "../src/utils/simd.c",
+                "../src/utils/threads.c",
+                "../src/utils/tour.c",
+                "../src/utils/tsplib.c",
+                "../src/utils/tspbin.c",
                 "../src/utils/utils.c"
             ],
             "include_dirs" : [